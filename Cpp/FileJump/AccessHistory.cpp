@@ -0,0 +1,166 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "AccessHistory.h"
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <ctime>
+#include <algorithm>
+
+static const char HISTORY_MAGIC[4] = { 'F', 'J', 'A', 'H' };
+
+AccessHistory::AccessHistory(size_t capacity, unsigned halfLifeHours)
+    : m_capacity(std::max<size_t>(capacity, 16)), m_halfLife(halfLifeHours * 3600.0)
+{
+}
+
+double AccessHistory::decayed(const Item& item, int64_t now) const
+{
+    if (now <= item.last || m_halfLife <= 0)
+        return item.score;
+    return item.score * std::exp2(-(double)(now - item.last) / m_halfLife);
+}
+
+void AccessHistory::touch(const std::string& path, bool isDir)
+{
+    int64_t now = (int64_t)std::time(nullptr);
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it = items.find(path);
+    if (it == items.end())
+    {
+        items[path] = { isDir, 1, 1.0, now };
+        if (items.size() > m_capacity)
+            trim(now);
+        return;
+    }
+    Item& item = it->second;
+    item.score = decayed(item, now) + 1;
+    item.last = now;
+    item.isDir = isDir;
+    item.count++;
+}
+
+// Drop the coldest quarter; m_mutex must be held
+void AccessHistory::trim(int64_t now)
+{
+    std::vector<std::pair<double, const std::string*>> scores;
+    scores.reserve(items.size());
+    for (auto& i : items)
+        scores.emplace_back(decayed(i.second, now), &i.first);
+    size_t drop = items.size() / 4;
+    std::nth_element(scores.begin(), scores.begin() + drop, scores.end());
+    std::vector<std::string> cold;
+    for (size_t i = 0; i < drop; i++)
+        cold.push_back(*scores[i].second);
+    for (auto& path : cold)
+        items.erase(path);
+}
+
+std::vector<AccessHistory::Entry> AccessHistory::hottest(size_t count, bool dirs) const
+{
+    int64_t now = (int64_t)std::time(nullptr);
+    std::vector<Entry> out;
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto& i : items)
+            if (i.second.isDir == dirs)
+                out.push_back({ i.first, i.second.isDir, i.second.count, decayed(i.second, now), i.second.last });
+    }
+    auto hotter = [](const Entry& a, const Entry& b) { return a.score > b.score; };
+    if (out.size() > count)
+    {
+        std::nth_element(out.begin(), out.begin() + count, out.end(), hotter);
+        out.resize(count);
+    }
+    std::sort(out.begin(), out.end(), hotter);
+    return out;
+}
+
+size_t AccessHistory::size() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return items.size();
+}
+
+bool AccessHistory::save(const std::string& file) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    uint64_t count = items.size();
+    out.write(HISTORY_MAGIC, 4);
+    out.write((const char*)&count, sizeof(count));
+    for (auto& i : items)
+    {
+        uint8_t isDir = i.second.isDir ? 1 : 0;
+        uint32_t length = (uint32_t)i.first.size();
+        out.write((const char*)&isDir, sizeof(isDir));
+        out.write((const char*)&i.second.count, sizeof(i.second.count));
+        out.write((const char*)&i.second.score, sizeof(i.second.score));
+        out.write((const char*)&i.second.last, sizeof(i.second.last));
+        out.write((const char*)&length, sizeof(length));
+        out.write(i.first.data(), length);
+    }
+    return (bool)out;
+}
+
+bool AccessHistory::load(const std::string& file)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in)
+        return false;
+    char magic[4];
+    uint64_t count = 0;
+    in.read(magic, 4);
+    in.read((char*)&count, sizeof(count));
+    if (!in || memcmp(magic, HISTORY_MAGIC, 4) != 0)
+        return false;
+    int64_t now = (int64_t)std::time(nullptr);
+    std::lock_guard<std::mutex> guard(m_mutex);
+    for (uint64_t i = 0; i < count; i++)
+    {
+        uint8_t isDir;
+        Item item;
+        uint32_t length;
+        in.read((char*)&isDir, sizeof(isDir));
+        in.read((char*)&item.count, sizeof(item.count));
+        in.read((char*)&item.score, sizeof(item.score));
+        in.read((char*)&item.last, sizeof(item.last));
+        in.read((char*)&length, sizeof(length));
+        if (!in || length > 32768)
+            return false;
+        std::string path(length, '\0');
+        in.read(&path[0], length);
+        if (!in)
+            return false;
+        item.isDir = isDir != 0;
+        items[path] = item;
+        if (items.size() > m_capacity)
+            trim(now);
+    }
+    return true;
+}
@@ -26,6 +26,8 @@
 
 #include "CUrlTools.h"
 #include <sstream>
+#include <cwchar>
+#include <cwctype>
 #include <wtypes.h>
 #include <vector>
 
@@ -69,6 +71,39 @@ FILEJUMP_API std::wstring CUrlTools::urlEncode(const std::wstring& value)
     return encoded.str();
 }
 
+FILEJUMP_API std::wstring CUrlTools::getQueryParam(const std::wstring& url, const std::wstring& name)
+{
+    size_t query = url.find(L'?');
+    if (query == std::wstring::npos)
+        return L"";
+    size_t pos = query + 1;
+    while (pos < url.length())
+    {
+        size_t end = url.find(L'&', pos);
+        if (end == std::wstring::npos)
+            end = url.length();
+        size_t eq = url.find(L'=', pos);
+        if (eq != std::wstring::npos && eq < end && url.compare(pos, eq - pos, name) == 0)
+        {
+            std::wstring value;
+            for (size_t i = eq + 1; i < end; i++)
+            {
+                // a '%' that does not start an escape is kept as it is
+                if (url[i] == L'%' && i + 2 < end && iswxdigit(url[i + 1]) && iswxdigit(url[i + 2]))
+                {
+                    value += (wchar_t)wcstol(url.substr(i + 1, 2).c_str(), nullptr, 16);
+                    i += 2;
+                }
+                else
+                    value += url[i];
+            }
+            return value;
+        }
+        pos = end + 1;
+    }
+    return L"";
+}
+
 // Convert wide string to UTF-8
 FILEJUMP_API std::string CUrlTools::WideToUtf8(const std::wstring& wstr) {
     if (wstr.empty()) return std::string();
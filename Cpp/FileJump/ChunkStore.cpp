@@ -0,0 +1,355 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "ChunkStore.h"
+#include "FJAccess.h"
+#include <windows.h>
+#include <bcrypt.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+
+#pragma comment(lib, "bcrypt.lib")
+
+namespace
+{
+    // Gear table of the rolling hash; generated with splitmix64 from a fixed seed, so chunk
+    // boundaries, and therefore chunk hashes, stay the same across builds and machines
+    struct GearTable
+    {
+        uint64_t g[256];
+        uint64_t ls[256];   // g << 1, used on the first byte of a two-byte step
+        constexpr GearTable() : g(), ls()
+        {
+            uint64_t s = 0x46696C654A756D70ULL;
+            for (int i = 0; i < 256; i++)
+            {
+                s += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = s;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                g[i] = z ^ (z >> 31);
+                ls[i] = g[i] << 1;
+            }
+        }
+    };
+    constexpr GearTable GEAR;
+
+    // Normalized chunking: a harder mask (22 bits) below the average size, an easier one (18 bits) above it.
+    // Bit k of the hash depends on the last k + 1 bytes, so the masks sit in bits 40..61 for a ~48 byte window.
+    const uint64_t MASK_S = ((1ULL << 22) - 1) << 40;
+    const uint64_t MASK_L = ((1ULL << 18) - 1) << 42;
+    const uint64_t MASK_S_LS = MASK_S << 1;
+    const uint64_t MASK_L_LS = MASK_L << 1;
+
+    const char* CHUNK_FOLDER = ".fjchunks";
+}
+
+ChunkStore::ChunkStore(FJAccess* access)
+    : m_access(access), m_rootId(-1)
+{
+}
+
+/**
+ * @brief Function finds the length of the next chunk
+ * @details FastCDC with two bytes per step: the hash is shifted by two and the first byte is
+ *          tested against the shifted mask, which gives the same boundaries as the one byte loop
+ *          with half of the loop overhead.
+ */
+size_t ChunkStore::cut(const unsigned char* data, size_t size)
+{
+    if (size <= MIN_CHUNK)
+        return size;
+    size_t n = std::min<size_t>(size, MAX_CHUNK);
+    size_t normal = std::min<size_t>(AVG_CHUNK, n);
+    uint64_t fp = 0;
+    size_t i = MIN_CHUNK;
+    for (; i + 1 < normal; i += 2)
+    {
+        fp = (fp << 2) + GEAR.ls[data[i]];
+        if (!(fp & MASK_S_LS))
+            return i + 1;
+        fp += GEAR.g[data[i + 1]];
+        if (!(fp & MASK_S))
+            return i + 2;
+    }
+    for (; i + 1 < n; i += 2)
+    {
+        fp = (fp << 2) + GEAR.ls[data[i]];
+        if (!(fp & MASK_L_LS))
+            return i + 1;
+        fp += GEAR.g[data[i + 1]];
+        if (!(fp & MASK_L))
+            return i + 2;
+    }
+    return n;
+}
+
+std::string ChunkStore::sha256(const char* data, size_t size)
+{
+    // CNG picks the SHA extensions of the CPU when it has them
+    unsigned char digest[32];
+    if (!BCRYPT_SUCCESS(BCryptHash(BCRYPT_SHA256_ALG_HANDLE, nullptr, 0, (PUCHAR)data, (ULONG)size, digest, sizeof(digest))))
+        return {};
+    static const char hex[] = "0123456789abcdef";
+    std::string out(64, '0');
+    for (int i = 0; i < 32; i++)
+    {
+        out[2 * i] = hex[digest[i] >> 4];
+        out[2 * i + 1] = hex[digest[i] & 15];
+    }
+    return out;
+}
+
+/**
+ * @brief Function returns the id of a folder, creating it when it does not exist
+ * @return id of the folder, -1 on failure
+ */
+int ChunkStore::folderId(int parentId, const std::string& name)
+{
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        for (auto& fi : m_access->getDirectoryContent(parentId))
+            if (fi.isDir && fi.name == name)
+                return fi.id;
+        if (attempt == 0 && !m_access->createDir(parentId, name))
+            return -1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Function returns the id of a stored chunk, -1 when the chunk is not stored yet
+ * @details A shard folder is listed once; chunks uploaded later are added to m_chunkIds directly.
+ */
+int ChunkStore::findChunk(int shardId, const std::string& hash)
+{
+    if (!m_listedShards.count(shardId))
+    {
+        for (auto& fi : m_access->getDirectoryContent(shardId))
+            if (!fi.isDir)
+                m_chunkIds[fi.name] = fi.id;
+        m_listedShards.insert(shardId);
+    }
+    auto it = m_chunkIds.find(hash);
+    return it == m_chunkIds.end() ? -1 : it->second;
+}
+
+bool ChunkStore::upload(const std::string& source, int parentId, const std::string& name, FileInfo* uploaded)
+{
+    std::ifstream in(source, std::ios::binary);
+    if (!in)
+        return false;
+
+    // One upload at a time, so two uploads do not create the same shard folder twice
+    std::lock_guard<std::mutex> guard(m_uploadMutex);
+    if (m_rootId < 0)
+        m_rootId = folderId(0, CHUNK_FOLDER);
+    if (m_rootId < 0)
+        return false;
+
+    class ChunkDir
+    {
+    public:
+        std::filesystem::path dir;
+        ~ChunkDir()
+        {
+            std::error_code ec;
+            if (!dir.empty())
+                std::filesystem::remove_all(dir, ec);
+        }
+    } temp;
+    std::filesystem::path sourcePath(source);
+    std::error_code ec;
+    temp.dir = sourcePath.parent_path() / ("fjcdc_" + sourcePath.filename().string());
+    std::filesystem::create_directories(temp.dir, ec);
+
+    auto manifest = std::make_shared<Manifest>();
+    uint64_t newBytes = 0;
+    std::vector<char> buf(2 * (size_t)MAX_CHUNK);
+    size_t pos = 0, have = 0;
+    bool eof = false;
+    while (true)
+    {
+        if (!eof && have - pos < MAX_CHUNK)
+        {
+            std::memmove(buf.data(), buf.data() + pos, have - pos);
+            have -= pos;
+            pos = 0;
+            in.read(buf.data() + have, buf.size() - have);
+            have += (size_t)in.gcount();
+            eof = !in;
+        }
+        if (pos == have)
+            break;
+        size_t len = cut((const unsigned char*)buf.data() + pos, have - pos);
+        std::string hash = sha256(buf.data() + pos, len);
+        if (hash.empty())
+            return false;
+
+        std::string shard = hash.substr(0, 2);
+        if (!m_shards.count(shard))
+        {
+            int id = folderId(m_rootId, shard);
+            if (id < 0)
+                return false;
+            m_shards[shard] = id;
+        }
+        int shardId = m_shards[shard];
+        int chunkId = findChunk(shardId, hash);
+        if (chunkId < 0)
+        {
+            std::string chunkPath = (temp.dir / hash).string();
+            {
+                std::ofstream out(chunkPath, std::ios::binary);
+                out.write(buf.data() + pos, len);
+                if (!out)
+                    return false;
+            }
+            FileInfo fi;
+            if (!m_access->uploadFile(chunkPath, shardId, hash, &fi, "fjfs chunk") || fi.id < 0)
+                return false;
+            std::filesystem::remove(chunkPath, ec);
+            chunkId = fi.id;
+            m_chunkIds[hash] = chunkId;
+            newBytes += len;
+        }
+        manifest->offsets.push_back(manifest->size);
+        manifest->chunks.push_back({ hash, len, chunkId });
+        manifest->size += len;
+        pos += len;
+    }
+
+    json j;
+    j["size"] = manifest->size;
+    j["chunks"] = json::array();
+    for (auto& c : manifest->chunks)
+        j["chunks"].push_back({ c.hash, c.size, c.id });
+    std::string manifestPath = (temp.dir / name).string();
+    {
+        std::ofstream out(manifestPath, std::ios::binary);
+        out << j.dump();
+        if (!out)
+            return false;
+    }
+    json marker;
+    marker["fjfs"] = { {"codec", "fastcdc"}, {"size", manifest->size} };
+    FileInfo entry;
+    if (!m_access->uploadFile(manifestPath, parentId, name, &entry, marker.dump()) || entry.id < 0)
+        return false;
+    entry.chunked = true;
+    entry.size = manifest->size;
+    if (FJAccess::verbose)
+        fprintf(stderr, "ChunkStore: %s %llu bytes in %d chunks, %llu bytes new\n", name.c_str(),
+            manifest->size, (int)manifest->chunks.size(), newBytes);
+
+    std::lock_guard<std::mutex> manifests(m_mutex);
+    m_files.insert(entry.id);
+    m_manifests[entry.id] = manifest;
+    if (uploaded)
+        *uploaded = entry;
+    return true;
+}
+
+void ChunkStore::add(int id)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_files.insert(id);
+}
+
+bool ChunkStore::contains(int id)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_files.count(id) != 0;
+}
+
+bool ChunkStore::loadManifest(int id, std::shared_ptr<const Manifest>& manifest)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = m_manifests.find(id);
+        if (it != m_manifests.end())
+        {
+            manifest = it->second;
+            return true;
+        }
+    }
+    std::string text;
+    if (!m_access->readRaw(id, 0, 0, text))
+        return false;
+    json j = json::parse(text, nullptr, false);
+    if (!j.is_object() || !j.contains("chunks") || !j["chunks"].is_array())
+        return false;
+    auto parsed = std::make_shared<Manifest>();
+    try
+    {
+        for (auto& c : j["chunks"])
+        {
+            Chunk chunk{ c[0].get<std::string>(), c[1].get<uint64_t>(), c[2].get<int>() };
+            parsed->offsets.push_back(parsed->size);
+            parsed->size += chunk.size;
+            parsed->chunks.push_back(chunk);
+        }
+    }
+    catch (const json::exception& e)
+    {
+        if (FJAccess::verbose)
+            fprintf(stderr, "ChunkStore: bad manifest %d: %s\n", id, e.what());
+        return false;
+    }
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_manifests[id] = parsed;
+    manifest = parsed;
+    return true;
+}
+
+/**
+ * @details Only the chunks that overlap the range are fetched, each with a ranged read.
+ */
+bool ChunkStore::read(int id, uint64_t offset, uint64_t length, std::string& out)
+{
+    std::shared_ptr<const Manifest> manifest;
+    if (!loadManifest(id, manifest))
+        return false;
+    out.clear();
+    if (offset >= manifest->size)
+        return true;
+    uint64_t end = (length && length < manifest->size - offset) ? offset + length : manifest->size;
+    out.reserve((size_t)(end - offset));
+
+    size_t i = std::upper_bound(manifest->offsets.begin(), manifest->offsets.end(), offset) - manifest->offsets.begin() - 1;
+    for (; i < manifest->chunks.size() && manifest->offsets[i] < end; i++)
+    {
+        const Chunk& chunk = manifest->chunks[i];
+        uint64_t from = std::max(offset, manifest->offsets[i]) - manifest->offsets[i];
+        uint64_t to = std::min(end, manifest->offsets[i] + chunk.size) - manifest->offsets[i];
+        std::string part;
+        if (!m_access->readRaw(chunk.id, from, to - from, part) || part.size() != to - from)
+            return false;
+        out += part;
+    }
+    return true;
+}
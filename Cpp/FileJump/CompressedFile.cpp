@@ -0,0 +1,260 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "CompressedFile.h"
+#include <windows.h>
+#include <compressapi.h>
+#include <fstream>
+#include <thread>
+#include <algorithm>
+#include <set>
+#include <cstring>
+
+#pragma comment(lib, "Cabinet.lib")
+
+namespace
+{
+    const char MAGIC[4] = { 'F', 'J', 'Z', '1' };
+
+    void put32(std::string& b, uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            b.push_back((char)((v >> (8 * i)) & 0xff));
+    }
+    void put64(std::string& b, uint64_t v)
+    {
+        put32(b, (uint32_t)v);
+        put32(b, (uint32_t)(v >> 32));
+    }
+    uint32_t get32(const std::string& b, size_t pos)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < 4; i++)
+            v |= (uint32_t)(unsigned char)b[pos + i] << (8 * i);
+        return v;
+    }
+    uint64_t get64(const std::string& b, size_t pos)
+    {
+        return (uint64_t)get32(b, pos) | ((uint64_t)get32(b, pos + 4) << 32);
+    }
+
+    /**
+     * Compresses one block; keeps it as is when compression does not make it smaller.
+     */
+    void packBlock(COMPRESSOR_HANDLE compressor, const std::string& block, std::string& packed, bool& stored)
+    {
+        SIZE_T written = 0;
+        packed.resize(block.size());
+        if (!block.empty() &&
+            Compress(compressor, block.data(), block.size(), &packed[0], packed.size(), &written) &&
+            written < block.size())
+        {
+            packed.resize(written);
+            stored = false;
+        }
+        else
+        {
+            packed = block;
+            stored = true;
+        }
+    }
+}
+
+FILEJUMP_API bool CompressedFile::compress(const std::string& source, const std::string& dest, uint64_t& originalSize, uint64_t& compressedSize)
+{
+    std::ifstream in(source, std::ios::binary);
+    if (!in.is_open())
+        return false;
+    std::ofstream out(dest, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return false;
+
+    // One compressor per worker: compressor handles are not thread safe
+    unsigned threads = (std::max)(1u, std::thread::hardware_concurrency());
+    std::vector<COMPRESSOR_HANDLE> compressors(threads, NULL);
+    for (auto& c : compressors)
+    {
+        if (!CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF | COMPRESS_RAW, NULL, &c))
+        {
+            for (auto h : compressors)
+                if (h)
+                    CloseCompressor(h);
+            return false;
+        }
+    }
+
+    std::vector<std::string> blocks(threads), packed(threads);
+    std::vector<char> stored(threads);
+    std::string table;
+    uint32_t count = 0;
+    originalSize = 0;
+    compressedSize = 0;
+    bool eof = false;
+    while (!eof)
+    {
+        // Read one block per worker, compress them in parallel, write them in order
+        size_t n = 0;
+        for (; n < threads; n++)
+        {
+            blocks[n].resize(BLOCK_SIZE);
+            in.read(&blocks[n][0], BLOCK_SIZE);
+            blocks[n].resize((size_t)in.gcount());
+            if (blocks[n].size() < BLOCK_SIZE)
+            {
+                eof = true;
+                if (!blocks[n].empty())
+                    n++;
+                break;
+            }
+        }
+        std::vector<std::thread> workers;
+        for (size_t t = 1; t < n; t++)
+            workers.emplace_back([&, t]() {
+                bool s;
+                packBlock(compressors[t], blocks[t], packed[t], s);
+                stored[t] = s;
+            });
+        if (n > 0)
+        {
+            bool s;
+            packBlock(compressors[0], blocks[0], packed[0], s);
+            stored[0] = s;
+        }
+        for (auto& w : workers)
+            w.join();
+
+        for (size_t t = 0; t < n; t++)
+        {
+            out.write(packed[t].data(), packed[t].size());
+            put32(table, (uint32_t)packed[t].size() | (stored[t] ? STORED_FLAG : 0));
+            put32(table, (uint32_t)blocks[t].size());
+            originalSize += blocks[t].size();
+            compressedSize += packed[t].size();
+            count++;
+        }
+    }
+    for (auto h : compressors)
+        CloseCompressor(h);
+
+    put32(table, count);
+    put32(table, BLOCK_SIZE);
+    put64(table, originalSize);
+    table.append(MAGIC, sizeof(MAGIC));
+    out.write(table.data(), table.size());
+    compressedSize += table.size();
+    out.close();
+    return !out.fail();
+}
+
+FILEJUMP_API bool CompressedFile::parseSeekTable(const std::string& tail, SeekTable& table, size_t& needed)
+{
+    needed = FOOTER_SIZE;
+    if (tail.size() < FOOTER_SIZE)
+        return false;
+    size_t footer = tail.size() - FOOTER_SIZE;
+    if (memcmp(tail.data() + footer + 16, MAGIC, sizeof(MAGIC)) != 0)
+    {
+        needed = 0;     // not a compressed file
+        return false;
+    }
+    uint32_t count = get32(tail, footer);
+    needed = FOOTER_SIZE + (size_t)count * 8;
+    if (tail.size() < needed)
+        return false;
+
+    table.blockSize = get32(tail, footer + 4);
+    table.size = get64(tail, footer + 8);
+    table.offsets.clear();
+    table.compressedSizes.clear();
+    table.sizes.clear();
+    uint64_t offset = 0;
+    size_t pos = tail.size() - needed;
+    for (uint32_t i = 0; i < count; i++, pos += 8)
+    {
+        uint32_t compressed = get32(tail, pos);
+        table.offsets.push_back(offset);
+        table.compressedSizes.push_back(compressed);
+        table.sizes.push_back(get32(tail, pos + 4));
+        offset += compressed & ~STORED_FLAG;
+    }
+    return true;
+}
+
+FILEJUMP_API bool CompressedFile::decompressBlocks(const SeekTable& table, size_t first, const std::string& data, std::string& out)
+{
+    DECOMPRESSOR_HANDLE decompressor = NULL;
+    if (!CreateDecompressor(COMPRESS_ALGORITHM_XPRESS_HUFF | COMPRESS_RAW, NULL, &decompressor))
+        return false;
+    out.clear();
+    bool ok = true;
+    size_t pos = 0;
+    for (size_t i = first; ok && i < table.sizes.size() && pos < data.size(); i++)
+    {
+        uint32_t compressed = table.compressedSizes[i] & ~STORED_FLAG;
+        if (pos + compressed > data.size())
+        {
+            ok = false;
+            break;
+        }
+        if (table.compressedSizes[i] & STORED_FLAG)
+            out.append(data, pos, compressed);
+        else
+        {
+            size_t at = out.size();
+            out.resize(at + table.sizes[i]);
+            SIZE_T written = 0;
+            ok = Decompress(decompressor, data.data() + pos, compressed, &out[at], table.sizes[i], &written) &&
+                written == table.sizes[i];
+        }
+        pos += compressed;
+    }
+    CloseDecompressor(decompressor);
+    return ok;
+}
+
+FILEJUMP_API bool CompressedFile::decompress(const std::string& file, std::string& out)
+{
+    SeekTable table;
+    size_t needed = 0;
+    if (!parseSeekTable(file, table, needed))
+        return false;
+    return decompressBlocks(table, 0, file, out) && out.size() == table.size;
+}
+
+FILEJUMP_API bool CompressedFile::isCompressible(const std::string& name)
+{
+    static const std::set<std::string> packed = {
+        "zip", "7z", "rar", "gz", "tgz", "bz2", "xz", "zst", "cab", "fjz",
+        "jpg", "jpeg", "png", "gif", "webp", "heic",
+        "mp3", "aac", "ogg", "flac", "mp4", "mkv", "avi", "mov", "webm",
+        "docx", "xlsx", "pptx", "pdf"
+    };
+    size_t dotPos = name.find_last_of('.');
+    if (dotPos == std::string::npos)
+        return true;
+    std::string ext = name.substr(dotPos + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return packed.count(ext) == 0;
+}
@@ -0,0 +1,337 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "ContentCache.h"
+#include <filesystem>
+#include <sstream>
+#include <iomanip>
+
+namespace fs = std::filesystem;
+
+ContentCache::ContentCache(const std::string& dir, uint64_t capacity)
+    : m_dir(dir), m_capacity(capacity)
+{
+    std::error_code ec;
+    fs::remove_all(m_dir, ec);
+    fs::create_directories(m_dir, ec);
+    m_stats.capacity = capacity;
+}
+
+ContentCache::~ContentCache()
+{
+    std::error_code ec;
+    fs::remove_all(m_dir, ec);
+}
+
+std::string ContentCache::acquire(int id, uint64_t version)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_stats.lookups++;
+    auto lit = lruIndex.find(id);
+    if (lit != lruIndex.end())
+    {
+        m_stats.lruHits++;
+        lru.splice(lru.begin(), lru, lit->second);
+    }
+    auto it = objects.find(id);
+    if (it == objects.end())
+        return "";
+    Object& o = it->second;
+    if (o.version != version)
+    {
+        drop(id);
+        return "";
+    }
+    if (o.freq < 3)
+        o.freq++;
+    o.pins++;
+    m_stats.hits++;
+    (o.inMain ? m_stats.mainHits : m_stats.smallHits)++;
+    return o.path;
+}
+
+bool ContentCache::contains(int id, uint64_t version) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it = objects.find(id);
+    return it != objects.end() && it->second.version == version;
+}
+
+std::string ContentCache::admit(int id, uint64_t version, const std::string& file, uint64_t size, bool& cached, bool keep)
+{
+    cached = false;
+    std::lock_guard<std::mutex> guard(m_mutex);
+    touchLru(id, size);
+    auto it = objects.find(id);
+    if (it != objects.end())
+    {
+        if (it->second.version == version)
+        {
+            if (keep)
+                setKept(id, true);
+            return file;            // cached meanwhile by another open
+        }
+        drop(id);
+    }
+    auto git = ghostIndex.find(id);
+    bool seen = git != ghostIndex.end();
+    if (!keep && (size > m_capacity || (size > m_capacity / 8 && !seen)))
+    {
+        m_stats.bypassed++;
+        addGhost(id);
+        return file;
+    }
+
+    std::string path = (fs::path(m_dir) / (std::to_string(id) + "_" + std::to_string(version))).string();
+    std::error_code ec;
+    fs::rename(file, path, ec);
+    if (ec)
+        return file;
+    if (seen)
+    {
+        ghost.erase(git->second);
+        ghostIndex.erase(git);
+        m_stats.ghostAdmitted++;
+    }
+    Object o = { version, size, path, 0, 1, seen, keep, {} };
+    if (keep)
+        keptBytes += size;
+    else
+    {
+        std::list<int>& queue = seen ? main : small;
+        queue.push_front(id);
+        o.pos = queue.begin();
+        (seen ? mainBytes : smallBytes) += size;
+    }
+    objects[id] = o;
+    paths[path] = id;
+    m_stats.admitted++;
+    cached = true;
+    evict();
+    return path;
+}
+
+void ContentCache::release(const std::string& path)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto oit = orphans.find(path);
+    if (oit != orphans.end())
+    {
+        if (--oit->second == 0)
+        {
+            std::error_code ec;
+            fs::remove(path, ec);
+            orphans.erase(oit);
+        }
+        return;
+    }
+    auto pit = paths.find(path);
+    if (pit != paths.end() && objects[pit->second].pins)
+        objects[pit->second].pins--;
+    evict();
+}
+
+void ContentCache::remove(int id)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (objects.count(id))
+        drop(id);
+}
+
+bool ContentCache::keep(int id, bool on)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    if (!objects.count(id))
+        return false;
+    setKept(id, on);
+    if (!on)
+        evict();
+    return true;
+}
+
+bool ContentCache::kept(int id) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it = objects.find(id);
+    return it != objects.end() && it->second.kept;
+}
+
+// Take an object out of the queues or put it back at the front of the main queue; m_mutex must be held
+void ContentCache::setKept(int id, bool on)
+{
+    Object& o = objects[id];
+    if (o.kept == on)
+        return;
+    o.kept = on;
+    if (on)
+    {
+        (o.inMain ? main : small).erase(o.pos);
+        (o.inMain ? mainBytes : smallBytes) -= o.size;
+        keptBytes += o.size;
+    }
+    else
+    {
+        keptBytes -= o.size;
+        main.push_front(id);
+        o.pos = main.begin();
+        o.inMain = true;
+        mainBytes += o.size;
+    }
+}
+
+// m_mutex must be held
+void ContentCache::drop(int id)
+{
+    auto it = objects.find(id);
+    Object& o = it->second;
+    if (o.kept)
+        keptBytes -= o.size;
+    else
+    {
+        (o.inMain ? main : small).erase(o.pos);
+        (o.inMain ? mainBytes : smallBytes) -= o.size;
+    }
+    if (o.pins)
+        orphans[o.path] = o.pins;
+    else
+    {
+        std::error_code ec;
+        fs::remove(o.path, ec);
+    }
+    paths.erase(o.path);
+    objects.erase(it);
+}
+
+// m_mutex must be held
+void ContentCache::addGhost(int id)
+{
+    if (ghostIndex.count(id))
+        return;
+    ghost.push_front(id);
+    ghostIndex[id] = ghost.begin();
+    size_t limit = objects.size() > 1024 ? objects.size() : 1024;
+    while (ghost.size() > limit)
+    {
+        ghostIndex.erase(ghost.back());
+        ghost.pop_back();
+    }
+}
+
+// m_mutex must be held
+void ContentCache::evict()
+{
+    // Every step either frees an object or moves one; pinned objects are skipped for a round
+    for (size_t step = 0; smallBytes + mainBytes > m_capacity && step < 4 * objects.size() + 4; step++)
+    {
+        bool fromSmall = !small.empty() && (smallBytes > m_capacity / 10 || main.empty());
+        std::list<int>& queue = fromSmall ? small : main;
+        if (queue.empty())
+            break;
+        int id = queue.back();
+        Object& o = objects[id];
+        if (fromSmall)
+        {
+            if (o.freq > 0 || o.pins)
+            {
+                main.splice(main.begin(), small, o.pos);
+                o.inMain = true;
+                smallBytes -= o.size;
+                mainBytes += o.size;
+                m_stats.promoted++;
+                continue;
+            }
+            drop(id);
+            addGhost(id);
+        }
+        else
+        {
+            if (o.freq > 0 || o.pins)
+            {
+                if (o.freq > 0)
+                    o.freq--;
+                main.splice(main.begin(), main, o.pos);
+                continue;
+            }
+            drop(id);
+        }
+        m_stats.evicted++;
+    }
+}
+
+// m_mutex must be held
+void ContentCache::touchLru(int id, uint64_t size)
+{
+    auto it = lruIndex.find(id);
+    if (it != lruIndex.end())
+    {
+        lruBytes -= it->second->second;
+        lru.erase(it->second);
+    }
+    lru.emplace_front(id, size);
+    lruIndex[id] = lru.begin();
+    lruBytes += size;
+    while (lruBytes > m_capacity && !lru.empty())
+    {
+        lruBytes -= lru.back().second;
+        lruIndex.erase(lru.back().first);
+        lru.pop_back();
+    }
+}
+
+ContentCache::Stats ContentCache::stats() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    Stats s = m_stats;
+    s.bytes = smallBytes + mainBytes;
+    s.keptBytes = keptBytes;
+    s.keptObjects = 0;
+    for (auto& o : objects)
+        if (o.second.kept)
+            s.keptObjects++;
+    s.objects = objects.size() - s.keptObjects;
+    return s;
+}
+
+std::string ContentCache::report() const
+{
+    Stats s = stats();
+    auto rate = [&](uint64_t hits)
+    {
+        std::ostringstream r;
+        r << std::fixed << std::setprecision(1) << (s.lookups ? 100.0 * hits / s.lookups : 0.0) << "%";
+        return r.str();
+    };
+    std::ostringstream out;
+    out << "content cache: " << (s.bytes >> 20) << " of " << (s.capacity >> 20) << " MB, " << s.objects << " files\n";
+    out << "lookups: " << s.lookups << "\n";
+    out << "S3-FIFO hits: " << s.hits << " (" << rate(s.hits) << "; small queue " << s.smallHits
+        << ", main queue " << s.mainHits << ")\n";
+    out << "LRU hits (shadow): " << s.lruHits << " (" << rate(s.lruHits) << ")\n";
+    out << "admitted: " << s.admitted << " (from ghost list " << s.ghostAdmitted << "), bypassed large: " << s.bypassed
+        << ", promoted: " << s.promoted << ", evicted: " << s.evicted << "\n";
+    if (s.keptObjects)
+        out << "kept for pinned folders: " << (s.keptBytes >> 20) << " MB, " << s.keptObjects << " files\n";
+    return out.str();
+}
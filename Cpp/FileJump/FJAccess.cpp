@@ -27,6 +27,13 @@
 #include <fstream>
 #include "CUrlTools.h"
 #include "fj_wininet.h"
+#include "ZipStreamReader.h"
+#include "TreeCrawler.h"
+#include <set>
+#include <filesystem>
+#include <cerrno>
+#include <cwchar>
+#include <chrono>
 #define JSON_DIAGNOSTICS 1
 #include <nlohmann/json.hpp>
 using json = nlohmann::json;
@@ -36,10 +43,13 @@ std::wstring FJAccess::m_bearerToken;
 FJAccess* FJAccess::instance;
 std::mutex FJAccess::m_cache_mutex;
 bool FJAccess::verbose = false;
+bool FJAccess::compress = false;
+uint64_t FJAccess::dedupMinSize = 0;
 
 FJAccess::FJAccess()
+    : m_chunks(this)
 {
-    directoryTranslate[0] = "/";
+    directoryTranslate.set(0, "/");
 }
 
 FILEJUMP_API FileInfo* FJAccess::json2fileinfo(const json& json_response, const std::string& subtree, FileInfo* buf)
@@ -57,17 +67,39 @@ FILEJUMP_API FileInfo* FJAccess::json2fileinfo(const json& json_response, const
     try {
         auto ttt = j["name"];
         buf->name = j["name"];
+        if (j.contains("hash") && j["hash"].is_string())
+            buf->hash = j["hash"];
         buf->path = CUrlTools::splitIntPath(j["path"]);
         buf->size = 0;
         buf->isDir = (j["type"] == "folder");
         if(!buf->isDir)
             buf->size = j["file_size"];
+        buf->storedSize = buf->size;
+        if (j.contains("description") && j["description"].is_string())
+            buf->description = j["description"];
+        // Marker written by uploadFile for transparently compressed or chunked content
+        if (!buf->isDir && j.contains("description") && j["description"].is_string())
+        {
+            json desc = json::parse(j["description"].get<std::string>(), nullptr, false);
+            if (desc.is_object() && desc.contains("fjfs") && desc["fjfs"].is_object())
+            {
+                std::string codec = desc["fjfs"].value("codec", "");
+                buf->compressed = (codec == "xpress-huff");
+                buf->chunked = (codec == "fastcdc");
+                if (buf->compressed || buf->chunked)
+                    buf->size = desc["fjfs"].value("size", (uint64_t)0);
+            }
+        }
         buf->id = j["id"];
         int parent_id = 0;
         if (j.contains("parent_id") && !j["parent_id"].is_null())
             buf->parent_id = j["parent_id"];
         buf->created_at = CUrlTools::StringToFileTime(j["created_at"]);
         buf->updated_at = CUrlTools::StringToFileTime(j["updated_at"]);
+        if (buf->compressed)
+            m_compression.add(buf->id, buf->storedSize);
+        if (buf->chunked)
+            m_chunks.add(buf->id);
     }
     catch (const json::exception& e)
     {
@@ -77,6 +109,37 @@ FILEJUMP_API FileInfo* FJAccess::json2fileinfo(const json& json_response, const
     return buf;
 }
 
+void FILEJUMP_API FJAccess::set_hedging(bool enabled)
+{
+    HttpSetHedging(enabled);
+}
+
+void FILEJUMP_API FJAccess::set_circuit_breaker(unsigned failures, unsigned openMs)
+{
+    HttpSetCircuitBreaker(failures, openMs);
+}
+
+bool FILEJUMP_API FJAccess::online()
+{
+    return HttpAvailable(HttpPool::Api);
+}
+
+std::string FILEJUMP_API FJAccess::transport_report()
+{
+    HttpHedgeStats stats = HttpGetHedgeStats();
+    std::string out = "hedged GETs: " + std::to_string(stats.hedged) + " of " + std::to_string(stats.requests) +
+        ", answered first: " + std::to_string(stats.hedgeWins) + ", delay: " + std::to_string(stats.thresholdMs) + " ms\n";
+    static const char* states[] = { "closed", "open", "half-open" };
+    for (HttpPool pool : { HttpPool::Api, HttpPool::Storage })
+    {
+        HttpCircuitStats circuit = HttpGetCircuitStats(pool);
+        out += std::string(pool == HttpPool::Api ? "API" : "storage") + " circuit: " + states[(int)circuit.state] +
+            ", failures: " + std::to_string(circuit.failures) + ", opened: " + std::to_string(circuit.trips) +
+            ", requests failed fast: " + std::to_string(circuit.rejected) + "\n";
+    }
+    return out;
+}
+
 bool FILEJUMP_API FJAccess::configure_with_password(const std::wstring& baseUrl, const std::string& user, const std::string& password)
 {
     class LoginFileTools
@@ -127,17 +190,21 @@ bool FILEJUMP_API FJAccess::configure_with_password(const std::wstring& baseUrl,
 /**
  * @brief Function retrieves list of files from FileJump
  * @param path_id integer ID of filejump directory
+ * @param query when not empty, the server returns only entries whose name contains it
+ * @param ok if given, set to false when a request failed and the list is incomplete
  * @return list of files
  */
-std::list<FileInfo> FILEJUMP_API FJAccess::get_files(int path_id)
+std::list<FileInfo> FILEJUMP_API FJAccess::get_files(int path_id, const std::string& query, bool* ok)
 {
     class GetFileTools
     {
     public:
-        static std::wstring get_url(std::wstring const& base_url, int path_id, int page)
+        static std::wstring get_url(std::wstring const& base_url, int path_id, int page, const std::string& query)
         {
             std::map<std::wstring, std::wstring> params = { {L"perPage", L"1000"}, {L"workspaceId", L"0"},
                 {L"parentIds", std::to_wstring(path_id)}, {L"page", std::to_wstring(page) } };
+            if (!query.empty())
+                params[L"query"] = CUrlTools::Utf8ToWide(query);
             return CUrlTools::buildUrlWithParams(base_url + std::wstring(L"api/v1/drive/file-entries"), params);
         };
         static std::wstring get_header(const std::wstring& token)
@@ -152,11 +219,13 @@ std::list<FileInfo> FILEJUMP_API FJAccess::get_files(int path_id)
     std::list<FileInfo> res;
     while (true)
     {
-        auto response = HttpGet(GetFileTools::get_url(m_baseUrl, path_id, next_page), 
+        auto response = HttpGet(GetFileTools::get_url(m_baseUrl, path_id, next_page, query), 
                                 GetFileTools::get_header(m_bearerToken));
         if (response.empty())
         {
             int error = GetLastError();
+            if (ok)
+                *ok = false;
             return res;
         }
         json j = json::parse(response);
@@ -174,6 +243,8 @@ std::list<FileInfo> FILEJUMP_API FJAccess::get_files(int path_id)
             {
                 FileInfo fi;
                 json2fileinfo(item, "", &fi);
+                if (m_indexReady)
+                    m_index.add(fi);
                 res.push_back(fi);
             }
         }
@@ -188,35 +259,48 @@ std::string FILEJUMP_API FJAccess::path2string(std::vector<int> path)
     std::string last = "root";
     for (auto s : path)
     {
-        out += directoryTranslate[s];
+        std::string name;
+        directoryTranslate.find(s, name);
+        out += name;
         if (out[out.length() - 1] != '/')
             out += "/";
     }
     return out;
 }
 
-void FILEJUMP_API FJAccess::read_directory_tree(int id)
+FILEJUMP_API const struct FileInfo* FJAccess::findFile(const std::string& path)
 {
-    // guard for external stop flag: you may map Globals.should_stop to an external atomic flag if needed
-    // For now we do not check for cancellation
-    auto entries = get_files(id);
-    for (auto& entry : entries) 
+    std::string parentPath = CUrlTools::getParentPath(path);
+    std::string name = CUrlTools::getName(path);
+    int parent_id = getDirectoryID(parentPath);
+
+    // In a large folder that is not cached, ask the server for the name instead of listing every page
+    size_t entries_count = 0;
+    bool large = folderSizes.find(parent_id, entries_count) && entries_count >= largeFolder && !m_lru.contains(parent_id);
+    if (large && !name.empty())
     {
-        if (entry.isDir) 
+        bool ok = true;
+        auto hits = get_files(parent_id, name, &ok);
+        if (ok)
         {
-            directoryTranslate[entry.id] = entry.name;
-            std::string path = path2string(entry.path);
-            directoryCache[path] = entry.id;
-            read_directory_tree(entry.id);
+            for (auto& e : hits)
+                if (e.name == name && (e.parent_id == parent_id || (parent_id == 0 && e.parent_id <= 0)))
+                    return new struct FileInfo(e);
+            return nullptr;
         }
+        if (verbose)
+            fprintf(stderr, "Lookup of %s by name failed, listing the folder\n", path.c_str());
+    }
+
+    // A known directory whose parent is not cached is read by id
+    int dir_id = large ? -1 : lookupDirectoryID(path);
+    if (dir_id > 0)
+    {
+        FileInfo fi;
+        if (!m_lru.contains(parent_id) && statEntry(dir_id, fi))
+            return new struct FileInfo(fi);
     }
-}
 
-FILEJUMP_API const struct FileInfo* FJAccess::findFile(const std::string& path)
-{
-    std::string parentPath = CUrlTools::getParentPath(path);
-    std::string name = CUrlTools::getName(path);
-    int parent_id = getDirectoryID(parentPath);
     auto entries = getDirectoryContent(parent_id);
     for (auto& e : entries)
     {
@@ -228,15 +312,73 @@ FILEJUMP_API const struct FileInfo* FJAccess::findFile(const std::string& path)
     return nullptr;
 }
 
-bool FILEJUMP_API FJAccess::copyFile(int id, const std::string& dest)
+// Parses a whole decimal number; false for an empty, partly numeric or out of range value
+static bool parseSeconds(const std::wstring& text, long long& out)
+{
+    if (text.empty())
+        return false;
+    wchar_t* end = nullptr;
+    errno = 0;
+    out = wcstoll(text.c_str(), &end, 10);
+    return errno == 0 && end == text.c_str() + text.size();
+}
+
+/**
+ * @brief Function calculates how long a signed storage URL may be reused
+ * @param url redirect target returned by file-entries
+ * @return time when the URL expires, with a safety margin
+ */
+static time_t signedUrlExpiry(const std::wstring& url)
 {
-    class CopyFileTools
+    const time_t margin = 30;
+    time_t now = time(nullptr);
+    // S3 SigV4: X-Amz-Date=20250101T120000Z&X-Amz-Expires=300
+    std::wstring amzDate = CUrlTools::getQueryParam(url, L"X-Amz-Date");
+    std::wstring amzExpires = CUrlTools::getQueryParam(url, L"X-Amz-Expires");
+    long long seconds = 0;
+    if (!amzDate.empty() && parseSeconds(amzExpires, seconds))
+    {
+        std::tm tm = {};
+        if (swscanf_s(amzDate.c_str(), L"%4d%2d%2dT%2d%2d%2dZ",
+            &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min, &tm.tm_sec) == 6)
+        {
+            tm.tm_year -= 1900;
+            tm.tm_mon -= 1;
+            time_t signedAt = _mkgmtime(&tm);
+            if (signedAt != (time_t)-1)
+                return signedAt + seconds - margin;
+        }
+    }
+    // S3 SigV2 / CloudFront use "Expires", Laravel signed routes use "expires"; both are unix time
+    std::wstring expires = CUrlTools::getQueryParam(url, L"Expires");
+    if (expires.empty())
+        expires = CUrlTools::getQueryParam(url, L"expires");
+    if (parseSeconds(expires, seconds))
+        return seconds - margin;
+    // Unknown signing scheme or a value that does not parse: reuse for a short time only
+    return now + 60;
+}
+
+/**
+ * @brief Function reads the object stored on the server, or a byte range of it
+ * @param id FileJump id of the file
+ * @param offset first byte to read
+ * @param length number of bytes to read, 0 = up to the end of file
+ * @param out receives the data
+ * @return true on success
+ * @details file-entries may redirect to object storage. The redirect is followed here rather than in WinInet:
+ *          the bearer token is sent to the API host only, and the signed storage URL is cached until it
+ *          expires, so repeated reads of the same file go straight to the storage host.
+ */
+bool FILEJUMP_API FJAccess::readRaw(int id, uint64_t offset, uint64_t length, std::string& out)
+{
+    class ReadFileTools
     {
     public:
         static std::wstring get_url(std::wstring const& base_url, int id)
         {
             std::map<std::wstring, std::wstring> params = {};
-            return CUrlTools::buildUrlWithParams(base_url + std::wstring(L"api/v1/file-entries/")+std::to_wstring(id), params);
+            return CUrlTools::buildUrlWithParams(base_url + std::wstring(L"api/v1/file-entries/") + std::to_wstring(id), params);
         };
         static std::wstring get_header(const std::wstring& token)
         {
@@ -245,11 +387,136 @@ bool FILEJUMP_API FJAccess::copyFile(int id, const std::string& dest)
                 {L"Authorization", L"Bearer " + token},
                 {L"User-Agent", L"WindowsHttpClient/1.0"} });
         }
+        static std::wstring get_storage_header()
+        {
+            return CUrlTools::createHeaders({
+                {L"User-Agent", L"WindowsHttpClient/1.0"} });
+        }
+        static bool take_body(HttpResponse& response, uint64_t offset, uint64_t length, std::string& out)
+        {
+            if (response.status == 206)
+            {
+                out.swap(response.body);
+                return true;
+            }
+            if (response.status != 200)
+                return false;
+            // Server ignored the Range header: cut the range out of the full body
+            if (offset || length)
+            {
+                if (offset >= response.body.length())
+                    response.body.clear();
+                else
+                    response.body = response.body.substr((size_t)offset, length ? (size_t)length : std::string::npos);
+            }
+            out.swap(response.body);
+            return true;
+        }
     };
-    std::wstring url = CopyFileTools::get_url(m_baseUrl, id);
-    std::wstring headers = CopyFileTools::get_header(m_bearerToken);
-    auto response = HttpGet(url, headers);
-    if (response.length() == 0)
+
+    std::wstring storageUrl;
+    if (m_storageUrls.get(id, storageUrl))
+    {
+        HttpResponse response = HttpGetNoRedirect(storageUrl, ReadFileTools::get_storage_header(), offset, length, HttpPool::Storage);
+        if (ReadFileTools::take_body(response, offset, length, out))
+            return true;
+        // URL was revoked or expired early - ask the API for a new one
+        m_storageUrls.remove(id);
+    }
+
+    HttpResponse response = HttpGetNoRedirect(ReadFileTools::get_url(m_baseUrl, id), ReadFileTools::get_header(m_bearerToken), offset, length);
+    for (int hops = 0; response.status >= 300 && response.status < 400 && !response.location.empty() && hops < 5; hops++)
+    {
+        std::wstring location = response.location;
+        if (location[0] == L'/')
+            location = m_baseUrl + location.substr(1);
+        if (location.compare(0, m_baseUrl.length(), m_baseUrl) == 0)
+        {
+            // Redirect within the API host keeps the credentials
+            response = HttpGetNoRedirect(location, ReadFileTools::get_header(m_bearerToken), offset, length);
+            continue;
+        }
+        if (verbose)
+            fprintf(stderr, "readFile: %d redirected to storage\n", id);
+        m_storageUrls.add(id, location, signedUrlExpiry(location));
+        response = HttpGetNoRedirect(location, ReadFileTools::get_storage_header(), offset, length, HttpPool::Storage);
+    }
+    return ReadFileTools::take_body(response, offset, length, out);
+}
+
+/**
+ * @brief Function reads the original content of a compressed file, or a byte range of it
+ * @param id FileJump id of the file
+ * @param storedSize size of the compressed object on the server
+ * @param offset first byte of the original content to read
+ * @param length number of bytes to read, 0 = up to the end of file
+ * @param out receives the data
+ * @return true on success
+ * @details The seek table at the end of the object is read once and kept in m_compression;
+ *          after that a range costs one request for the compressed blocks that cover it.
+ */
+bool FILEJUMP_API FJAccess::readCompressed(int id, uint64_t storedSize, uint64_t offset, uint64_t length, std::string& out)
+{
+    CompressedFile::SeekTable table;
+    if (!m_compression.getTable(id, table))
+    {
+        // The tail normally holds the whole table (8 bytes per MB of content)
+        uint64_t tailSize = (std::min)(storedSize, (uint64_t)64 * 1024);
+        std::string tail;
+        size_t needed = 0;
+        if (!readRaw(id, storedSize - tailSize, tailSize, tail))
+            return false;
+        if (!CompressedFile::parseSeekTable(tail, table, needed))
+        {
+            if (needed <= tail.size() || needed > storedSize)
+                return false;
+            if (!readRaw(id, storedSize - needed, needed, tail) || !CompressedFile::parseSeekTable(tail, table, needed))
+                return false;
+        }
+        m_compression.setTable(id, table);
+    }
+
+    out.clear();
+    if (offset >= table.size || table.sizes.empty())
+        return true;
+    uint64_t end = length ? (std::min)(offset + length, table.size) : table.size;
+    size_t first = (size_t)(offset / table.blockSize);
+    size_t last = (size_t)((end - 1) / table.blockSize);
+    uint64_t from = table.offsets[first];
+    uint64_t to = table.offsets[last] + (table.compressedSizes[last] & ~CompressedFile::STORED_FLAG);
+    std::string packed, blocks;
+    if (!readRaw(id, from, to - from, packed) || !CompressedFile::decompressBlocks(table, first, packed, blocks))
+        return false;
+    uint64_t skip = offset - (uint64_t)first * table.blockSize;
+    if (skip >= blocks.size())
+        return false;
+    out = blocks.substr((size_t)skip, (size_t)(end - offset));
+    return true;
+}
+
+/**
+ * @brief Function reads the content of a file, or a byte range of it
+ * @param id FileJump id of the file
+ * @param offset first byte to read
+ * @param length number of bytes to read, 0 = up to the end of file
+ * @param out receives the data
+ * @return true on success
+ * @details Files uploaded with compression are decompressed transparently, chunked files are reassembled.
+ */
+bool FILEJUMP_API FJAccess::readFile(int id, uint64_t offset, uint64_t length, std::string& out)
+{
+    if (m_chunks.contains(id))
+        return m_chunks.read(id, offset, length, out);
+    uint64_t storedSize = 0;
+    if (m_compression.get(id, storedSize))
+        return readCompressed(id, storedSize, offset, length, out);
+    return readRaw(id, offset, length, out);
+}
+
+bool FILEJUMP_API FJAccess::copyFile(int id, const std::string& dest)
+{
+    std::string response;
+    if (!readFile(id, 0, 0, response))
         return false;
     std::ofstream outFile(dest, std::ios::binary);
     outFile.write(response.c_str(), response.length());
@@ -259,6 +526,149 @@ bool FILEJUMP_API FJAccess::copyFile(int id, const std::string& dest)
 
     return true;
 }
+/**
+ * @brief Function downloads many files with a few requests, as archives the server builds on the fly
+ * @param entries files to download; folders are skipped
+ * @param onFile called with every downloaded file and its content; return false to stop
+ * @return true when every file was delivered
+ * @details Files are requested in batches through file-entries/download/{hash,hash,...}. The archive
+ *          is unpacked while it streams in, so nothing but the current entry is held in memory.
+ *          A batch never contains two files with the same name, since the server would rename one
+ *          of them inside the archive. Files without a hash, single-file batches and files missing
+ *          from a failed archive are read one by one.
+ */
+bool FILEJUMP_API FJAccess::downloadArchive(const std::list<FileInfo>& entries, const std::function<bool(const FileInfo&, const std::string&)>& onFile)
+{
+    class ArchiveTools
+    {
+    public:
+        static std::wstring get_url(std::wstring const& base_url, const std::vector<const FileInfo*>& batch)
+        {
+            std::wstring hashes;
+            for (auto e : batch)
+            {
+                if (!hashes.empty())
+                    hashes += L",";
+                hashes += CUrlTools::Utf8ToWide(e->hash);
+            }
+            std::map<std::wstring, std::wstring> params = {};
+            return CUrlTools::buildUrlWithParams(base_url + std::wstring(L"api/v1/file-entries/download/") + hashes, params);
+        };
+        static std::wstring get_header(const std::wstring& token)
+        {
+            return CUrlTools::createHeaders({
+                {L"Accept", L"application/zip, */*"},
+                {L"Authorization", L"Bearer " + token},
+                {L"User-Agent", L"WindowsHttpClient/1.0"} });
+        }
+    };
+    const size_t MAX_BATCH = 100;
+
+    // Split into batches with unique names
+    std::vector<std::vector<const FileInfo*>> batches;
+    std::vector<std::set<std::string>> batchNames;
+    std::vector<const FileInfo*> single;
+    for (auto& e : entries)
+    {
+        if (e.isDir)
+            continue;
+        // The archive would hold the manifest of a chunked file, not its content
+        if (e.hash.empty() || e.chunked)
+        {
+            single.push_back(&e);
+            continue;
+        }
+        size_t b = 0;
+        while (b < batches.size() && (batches[b].size() >= MAX_BATCH || batchNames[b].count(e.name)))
+            b++;
+        if (b == batches.size())
+        {
+            batches.emplace_back();
+            batchNames.emplace_back();
+        }
+        batches[b].push_back(&e);
+        batchNames[b].insert(e.name);
+    }
+
+    bool stopped = false;
+    for (auto& batch : batches)
+    {
+        if (stopped)
+            break;
+        if (batch.size() == 1)
+        {
+            single.push_back(batch[0]);
+            continue;
+        }
+        std::unordered_map<std::string, const FileInfo*> byName;
+        for (auto e : batch)
+            byName[e->name] = e;
+
+        ZipStreamReader reader([&](const std::string& name, const std::string& data)
+            {
+                auto it = byName.find(CUrlTools::getName(name));
+                if (it == byName.end())
+                    return true;
+                const FileInfo* e = it->second;
+                std::string original;
+                if (e->compressed && !CompressedFile::decompress(data, original))
+                    return true;    // left in byName, read again separately
+                byName.erase(it);
+                if (!onFile(*e, e->compressed ? original : data))
+                {
+                    stopped = true;
+                    return false;
+                }
+                return true;
+            });
+        HttpResponse response = HttpGetStream(ArchiveTools::get_url(m_baseUrl, batch), ArchiveTools::get_header(m_bearerToken),
+            [&](const char* data, size_t size) { return reader.feed(data, size); });
+        if (response.status >= 200 && response.status < 300 && !stopped)
+            reader.finish();
+        if (verbose)
+            fprintf(stderr, "downloadArchive: %d files, status %lu, %d not delivered\n",
+                (int)batch.size(), response.status, (int)byName.size());
+        // Whatever the archive did not deliver is fetched separately
+        for (auto& rest : byName)
+            single.push_back(rest.second);
+    }
+
+    bool ok = true;
+    for (auto e : single)
+    {
+        if (stopped)
+            return false;
+        std::string data;
+        if (!readFile(e->id, 0, 0, data))
+        {
+            ok = false;
+            continue;
+        }
+        stopped = !onFile(*e, data);
+    }
+    return ok && !stopped;
+}
+
+/**
+ * @brief Function downloads many files into a local directory, see downloadArchive above
+ * @param entries files to download
+ * @param targetDir local directory the files are written to
+ * @return true when every file was written
+ */
+bool FILEJUMP_API FJAccess::downloadArchive(const std::list<FileInfo>& entries, const std::string& targetDir)
+{
+    bool written = true;
+    bool ok = downloadArchive(entries, [&](const FileInfo& e, const std::string& data)
+        {
+            std::ofstream outFile(targetDir + "\\" + e.name, std::ios::binary);
+            outFile.write(data.c_str(), data.length());
+            if (outFile.bad() || outFile.fail())
+                written = false;
+            return true;
+        });
+    return ok && written;
+}
+
 bool FILEJUMP_API FJAccess::deleteFile(int parent_id, int id)
 {
     class DeleteFileTools
@@ -289,13 +699,24 @@ bool FILEJUMP_API FJAccess::deleteFile(int parent_id, int id)
     };
 
     std::string deleteResponse = HttpPost(DeleteFileTools::get_url(m_baseUrl), DeleteFileTools::get_header(m_bearerToken), DeleteFileTools::getData(id));
-    m_lru.remove(parent_id);
-    if (!deleteResponse.empty())
-        return false;
-    return true;
+    json status = json::parse(deleteResponse, nullptr, false);
+    bool deleted = status.is_object() && status.value("status", "") == "success";
+    {
+        std::lock_guard<std::mutex> guard(m_cache_mutex);
+        if (deleted)
+        {
+            m_lru.erase(parent_id, id);
+            forgetDirectory(id);
+        }
+        else
+            m_lru.remove(parent_id);
+    }
+    if (deleted && m_indexReady)
+        m_index.remove(id);
+    return deleted;
 }
 
-bool FILEJUMP_API FJAccess::createDir(int id, const std::string& name)
+bool FILEJUMP_API FJAccess::createDir(int id, const std::string& name, FileInfo* created)
 {
     class CreateFolderTools
     {
@@ -331,18 +752,46 @@ bool FILEJUMP_API FJAccess::createDir(int id, const std::string& name)
     auto j = json_response["folder"];
     FileInfo fi;
     json2fileinfo(json_response, "folder", &fi);
-    m_lru.remove(fi.parent_id);
+    if (created)
+        *created = fi;
 
-    std::lock_guard<std::mutex> guard(m_cache_mutex);
-    directoryTranslate[fi.id] = fi.name;
-    std::string path = path2string(fi.path);
-    directoryCache[path] = fi.id;
-
-    // Set headers
+    applyCreated(fi);
     return true;
 }
 
-bool FILEJUMP_API FJAccess::uploadFile(const std::string& source, int remotePath, const std::string& remoteName)
+/**
+ * @brief Function applies an entry returned by a create or upload to the cached listing of its parent,
+ *        the directory cache and the name index, so the parent does not have to be listed again
+ */
+void FILEJUMP_API FJAccess::applyCreated(const FileInfo& fi)
+{
+    if (fi.id < 0)
+        return;
+    int parent_id = fi.parent_id > 0 ? fi.parent_id : 0;
+    {
+        std::lock_guard<std::mutex> guard(m_cache_mutex);
+        m_lru.put(parent_id, fi);
+        if (fi.isDir)
+        {
+            registerDirectories({ fi });
+            m_lru.add(fi.id, {});
+        }
+    }
+    if (m_indexReady)
+        m_index.add(fi);
+}
+
+/**
+ * @brief Function uploads a file
+ * @param uploaded receives the created entry, may be nullptr
+ * @param description description of the entry; when set, the file is uploaded as it is,
+ *        without compression or chunking (used for the objects of ChunkStore)
+ * @param cancel stops the upload when cancelled from another thread or past its deadline; the upload then fails.
+ *        nullptr uses the token installed on the calling thread, if any
+ * @return true when the server created the entry; a failed or cancelled upload returns false, it never throws
+ */
+bool FILEJUMP_API FJAccess::uploadFile(const std::string& source, int remotePath, const std::string& remoteName,
+    FileInfo* uploaded, const std::string& description, const CancellationToken* cancel)
 {
     class UploadFileTools
     {
@@ -368,7 +817,7 @@ bool FILEJUMP_API FJAccess::uploadFile(const std::string& source, int remotePath
     {
         {"parentId", std::to_string(remotePath)},
         {"relativePath", remoteName},
-        {"description", "Uploaded via API"}
+        {"description", description.empty() ? "Uploaded via API" : description}
     };
     
     // Files to upload
@@ -377,53 +826,409 @@ bool FILEJUMP_API FJAccess::uploadFile(const std::string& source, int remotePath
         {"file", source.c_str()}  // field name, file path
     };
     
-    std::string multipartResponse = HttpPostMultipart(UploadFileTools::get_url(m_baseUrl), m_bearerToken, fields, source.c_str());
+    // Transparent compression: upload the seekable compressed form under the same file name
+    class PackedDir
+    {
+    public:
+        std::filesystem::path dir;
+        ~PackedDir()
+        {
+            std::error_code ec;
+            if (!dir.empty())
+                std::filesystem::remove_all(dir, ec);
+        }
+    } packed;
+    std::string uploadPath = source;
+    if (description.empty() && dedupMinSize)
+    {
+        std::error_code ec;
+        uint64_t size = std::filesystem::file_size(source, ec);
+        if (!ec && size >= dedupMinSize)
+            return m_chunks.upload(source, remotePath, remoteName, uploaded);
+    }
+    if (compress && description.empty() && CompressedFile::isCompressible(remoteName))
+    {
+        std::filesystem::path sourcePath(source);
+        std::error_code ec;
+        packed.dir = sourcePath.parent_path() / ("fjz_" + sourcePath.filename().string());
+        std::filesystem::create_directories(packed.dir, ec);
+        std::string packedPath = (packed.dir / sourcePath.filename()).string();
+        uint64_t originalSize = 0, compressedSize = 0;
+        // Small files and files that shrink by less than 10% are not worth a decompression on every read
+        if (CompressedFile::compress(source, packedPath, originalSize, compressedSize) &&
+            originalSize >= 4096 && compressedSize < originalSize - originalSize / 10)
+        {
+            json marker;
+            marker["fjfs"] = { {"codec", "xpress-huff"}, {"size", originalSize} };
+            fields["description"] = marker.dump();
+            uploadPath = packedPath;
+            if (verbose)
+                fprintf(stderr, "uploadFile: %s compressed %llu -> %llu\n", remoteName.c_str(), originalSize, compressedSize);
+        }
+    }
+
+    std::string multipartResponse;
+    try
+    {
+        multipartResponse = HttpPostMultipart(UploadFileTools::get_url(m_baseUrl), m_bearerToken, fields, uploadPath.c_str(), cancel);
+    }
+    catch (const std::exception& e)
+    {
+        // connect, send and stream failures, an unexpected status and unreadable files all end here
+        fprintf(stderr, "uploadFile: %s: %s\n", remoteName.c_str(), e.what());
+        return false;
+    }
     if (multipartResponse.empty()) 
     {
         return false;
     }
-    json json_response = json::parse(multipartResponse);
+    json json_response = json::parse(multipartResponse, nullptr, false);
+    if (json_response.is_discarded())
+    {
+        fprintf(stderr, "uploadFile: %s: unexpected response\n", remoteName.c_str());
+        return false;
+    }
     if (json_response.contains("fileEntry"))
     {
-        auto file = json_response["fileEntry"];
-        if (file.contains("parent_id"))
-        {
-            auto parent_id = file["parent_id"];
-            m_lru.remove(parent_id);
-        }
+        FileInfo fi;
+        json2fileinfo(json_response, "fileEntry", &fi);
+        applyCreated(fi);
+        if (uploaded)
+            *uploaded = fi;
     }
     return true;
 }
 
 
+// Add the folders among entries to the directory cache, with one copy per shard; m_cache_mutex must be held
+void FILEJUMP_API FJAccess::registerDirectories(const std::list<FileInfo>& entries)
+{
+    std::vector<std::pair<int, std::string>> names;
+    for (auto& entry : entries)
+        if (entry.isDir)
+            names.emplace_back(entry.id, entry.name);
+    if (names.empty())
+        return;
+    // Names first: the paths are built from them
+    directoryTranslate.set(names);
+    std::vector<std::pair<std::string, int>> paths;
+    for (auto& entry : entries)
+        if (entry.isDir)
+            paths.emplace_back(path2string(entry.path), entry.id);
+    directoryCache.set(paths);
+}
+
+static uint64_t steadyMs()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Fills the directory cache when it is empty. A warm-up crawl that is running already is waited
+// for instead of crawling the tree a second time; only when it stopped early is the tree crawled here.
+// After a failed crawl, lookups find nothing for CRAWL_RETRY_MS instead of each crawling again
+void FILEJUMP_API FJAccess::ensureDirectoryCache()
+{
+    if (!directoryCache.empty() || steadyMs() < m_crawlRetryAt)
+        return;
+    // not under m_cache_mutex: the warm-up takes it to publish its folders
+    waitForWarmup();
+    if (!directoryCache.empty())
+        return;
+    std::lock_guard<std::mutex> guard(m_cache_mutex);
+    if (directoryCache.empty() && steadyMs() >= m_crawlRetryAt)
+        fillDirectoryCache();
+}
+
+void FILEJUMP_API FJAccess::waitForWarmup()
+{
+    std::unique_lock<std::mutex> lock(m_warmup_mutex);
+    m_warmupDone.wait(lock, [this] { return m_warmups == 0; });
+}
+
+// Called with m_cache_mutex held. The folders are published at the end, so lock-free lookups
+// keep seeing an empty cache, and wait for the lock, until the cache is complete
 void FILEJUMP_API FJAccess::fillDirectoryCache()
 {
-    directoryCache["/"] = 0;
-    read_directory_tree(0);
+    bool indexing = !m_indexReady;
+    if (indexing)
+        m_index.clear();
+    std::list<FileInfo> dirs;
+    TreeCrawler crawler(this);
+    bool complete = crawler.crawl(0, [&](int, const std::list<FileInfo>& entries)
+        {
+            for (auto& fi : entries)
+            {
+                if (fi.isDir)
+                    dirs.push_back(fi);
+                if (indexing)
+                    m_index.add(fi);
+            }
+        });
+    // a partial tree stays unpublished; the first lookup after the retry interval crawls again
+    if (!complete)
+    {
+        m_crawlRetryAt = steadyMs() + CRAWL_RETRY_MS;
+        return;
+    }
+    m_crawlRetryAt = 0;
+    registerDirectories(dirs);
+    directoryCache.set("/", 0);
+    if (indexing)
+        m_indexReady = true;
 }
 
 std::list<FileInfo> FILEJUMP_API FJAccess::getDirectoryContent(int directoryID)
 {
+    std::list<FileInfo> out;
+    if (m_lru.get(directoryID, out))
+        return out;
+    // Fetched without the lock, so listings of different folders load in parallel
+    bool ok = true;
+    out = get_files(directoryID, "", &ok);
+    // a failed listing is not cached as an empty folder
+    if (!ok)
+        return out;
     std::lock_guard<std::mutex> guard(m_cache_mutex);
-    std::list<FileInfo> out = m_lru.get(directoryID);
-    if (out.empty())
+    m_lru.add(directoryID, out);
+    folderSizes.set(directoryID, out.size());
+    return out;
+}
+
+// Drop a deleted directory and every folder under it from the caches; m_cache_mutex must be held.
+// The folders below are found by path in the directory cache and through the cached listings
+void FILEJUMP_API FJAccess::forgetDirectory(int id)
+{
+    std::unordered_set<int> tree = { id };
+    std::string prefix;
+    directoryCache.forEach([&](const std::string& path, int dir)
+        {
+            if (dir == id)
+                prefix = path;
+        });
+    if (!prefix.empty())
+        directoryCache.forEach([&](const std::string& path, int dir)
+            {
+                if (path.compare(0, prefix.size(), prefix) == 0)
+                    tree.insert(dir);
+            });
+    std::vector<int> pending(tree.begin(), tree.end());
+    while (!pending.empty())
     {
-        out = get_files(directoryID);
-        m_lru.add(directoryID, out);
+        std::list<FileInfo> listing;
+        bool listed = m_lru.get(pending.back(), listing);
+        pending.pop_back();
+        if (listed)
+            for (auto& e : listing)
+                if (e.isDir && tree.insert(e.id).second)
+                    pending.push_back(e.id);
     }
+    directoryCache.eraseIf([&tree](const std::string&, int dir) { return tree.count(dir) != 0; });
+    for (int dir : tree)
+    {
+        m_lru.remove(dir);
+        directoryTranslate.erase(dir);
+        folderSizes.erase(dir);
+    }
+}
+
+std::string FILEJUMP_API FJAccess::getDirectoryPath(int id)
+{
+    if (id == 0)
+        return "/";
+    std::string out;
+    directoryCache.forEach([&](const std::string& path, int dir)
+        {
+            if (dir == id)
+                out = path;
+        });
     return out;
 }
 
-int FILEJUMP_API FJAccess::getDirectoryID(std::string const &directoryPath)
+std::vector<int> FILEJUMP_API FJAccess::cachedDirectories()
+{
+    return m_lru.keys();
+}
+
+void FILEJUMP_API FJAccess::keepDirectory(int id, bool keep)
 {
     std::lock_guard<std::mutex> guard(m_cache_mutex);
-    if (directoryCache.empty())
-        fillDirectoryCache();
+    m_lru.keep(id, keep);
+}
+
+bool FILEJUMP_API FJAccess::refreshDirectory(int id, std::vector<DirectoryChange>& changes)
+{
+    bool ok = true;
+    std::list<FileInfo> fresh = get_files(id, "", &ok);
+    if (!ok)
+        return false;
+    std::list<FileInfo> old;
+    {
+        std::lock_guard<std::mutex> guard(m_cache_mutex);
+        if (!m_lru.update(id, fresh, old))
+            return false;
+        folderSizes.set(id, fresh.size());
+    }
+
+    std::unordered_map<int, const FileInfo*> before;
+    for (auto& e : old)
+        before[e.id] = &e;
+    for (auto& e : fresh)
+    {
+        auto it = before.find(e.id);
+        if (it == before.end())
+            changes.push_back({ DirectoryChange::Added, e });
+        else
+        {
+            const FileInfo& o = *it->second;
+            if (o.name != e.name)
+            {
+                changes.push_back({ DirectoryChange::Removed, o });
+                changes.push_back({ DirectoryChange::Added, e });
+            }
+            else if (o.size != e.size || CompareFileTime(&o.updated_at, &e.updated_at) != 0)
+                changes.push_back({ DirectoryChange::Modified, e });
+            before.erase(it);
+        }
+    }
+    for (auto& b : before)
+        changes.push_back({ DirectoryChange::Removed, *b.second });
+
+    std::lock_guard<std::mutex> guard(m_cache_mutex);
+    for (auto& c : changes)
+    {
+        if (c.entry.isDir && c.kind == DirectoryChange::Removed)
+            forgetDirectory(c.entry.id);
+        else if (c.entry.isDir && c.kind == DirectoryChange::Added)
+            registerDirectories({ c.entry });
+        if (m_indexReady && c.kind == DirectoryChange::Removed)
+            m_index.remove(c.entry.id);
+    }
+    return true;
+}
+
+int FILEJUMP_API FJAccess::lookupDirectoryID(std::string const& directoryPath)
+{
+    ensureDirectoryCache();
+
+    std::string p = directoryPath;
+    if (p.length() == 0 || p[p.length() - 1] != '/')
+        p += "/";
+    int found_id = -1;
+    directoryCache.find(p, found_id);
+    return found_id;
+}
+
+bool FILEJUMP_API FJAccess::statEntry(int id, FileInfo& out)
+{
+    class StatTools
+    {
+    public:
+        static std::wstring get_url(std::wstring const& base_url, int id)
+        {
+            std::map<std::wstring, std::wstring> params = {};
+            return CUrlTools::buildUrlWithParams(base_url + std::wstring(L"api/v1/file-entries/") + std::to_wstring(id) + L"/model", params);
+        };
+        static std::wstring get_header(const std::wstring& token)
+        {
+            return CUrlTools::createHeaders({
+                {L"Accept", L"application/json"},
+                {L"Authorization", L"Bearer " + token},
+                {L"User-Agent", L"WindowsHttpClient/1.0"} });
+        }
+    };
+    std::string response = HttpGet(StatTools::get_url(m_baseUrl, id), StatTools::get_header(m_bearerToken));
+    if (response.empty())
+        return false;
+    json j = json::parse(response, nullptr, false);
+    if (!j.is_object() || !j.contains("fileEntry") || !j["fileEntry"].is_object())
+        return false;
+    FileInfo fi;
+    json2fileinfo(j, "fileEntry", &fi);
+    if (fi.id != id)
+        return false;
+    out = fi;
+    return true;
+}
+
+bool FILEJUMP_API FJAccess::buildIndex(unsigned threads)
+{
+    TreeCrawler crawler(this, threads);
+    warmup(crawler);
+    return m_index.size() > 0;
+}
+
+bool FILEJUMP_API FJAccess::warmup(TreeCrawler& crawler, const TreeCrawler::OnProgress& progress)
+{
+    {
+        std::lock_guard<std::mutex> guard(m_warmup_mutex);
+        m_warmups++;
+    }
+    m_indexReady = false;
+    m_index.clear();
+    // Folders are merged at the end: a partly filled directory cache would look complete to lookups
+    std::list<FileInfo> dirs;
+    bool complete = crawler.crawl(0, [&](int, const std::list<FileInfo>& entries)
+        {
+            for (auto& fi : entries)
+            {
+                m_index.add(fi);
+                if (fi.isDir)
+                    dirs.push_back(fi);
+            }
+        }, progress);
+    if (complete)
+    {
+        std::lock_guard<std::mutex> guard(m_cache_mutex);
+        registerDirectories(dirs);
+        directoryCache.set("/", 0);
+    }
+    if (verbose)
+        fprintf(stderr, "Indexed %zu entries%s\n", m_index.size(), complete ? "" : " (incomplete)");
+    // an incomplete index is built again by the next search
+    m_indexReady = complete;
+    {
+        std::lock_guard<std::mutex> guard(m_warmup_mutex);
+        m_warmups--;
+    }
+    m_warmupDone.notify_all();
+    return complete;
+}
+
+std::vector<NameIndex::Match> FILEJUMP_API FJAccess::search(const NameIndex::Query& query, bool build)
+{
+    if (!m_indexReady && build)
+    {
+        std::lock_guard<std::mutex> guard(m_index_mutex);
+        if (!m_indexReady)
+            buildIndex();
+    }
+    return m_index.search(query);
+}
+
+bool FILEJUMP_API FJAccess::saveIndex(const std::string& file)
+{
+    if (!m_indexReady)
+        return false;
+    return m_index.save(file);
+}
+
+bool FILEJUMP_API FJAccess::loadIndex(const std::string& file)
+{
+    if (!m_index.load(file))
+        return false;
+    m_indexReady = true;
+    return true;
+}
+
+int FILEJUMP_API FJAccess::getDirectoryID(std::string const &directoryPath)
+{
+    ensureDirectoryCache();
 
     std::string p = directoryPath;
     if (p.length()==0 || p[p.length() - 1] != '/')
         p += "/";
-    int found_id = directoryCache[p];
+    int found_id = 0;
+    directoryCache.find(p, found_id);
     return found_id;
 }
 
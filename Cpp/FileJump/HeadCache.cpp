@@ -0,0 +1,147 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "HeadCache.h"
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+
+static const char HEADS_MAGIC[4] = { 'F', 'J', 'H', 'C' };
+
+HeadCache::HeadCache(size_t headSize, uint64_t capacity)
+    : m_headSize(headSize), m_capacity(capacity)
+{
+}
+
+bool HeadCache::read(int id, uint64_t version, uint64_t offset, size_t length, char* buf, size_t& got)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it = heads.find(id);
+    if (it == heads.end() || it->second.version != version)
+        return false;
+    const std::string& data = it->second.data;
+    bool whole = data.size() < m_headSize;
+    if (offset + length > data.size() && !whole)
+        return false;
+    got = offset < data.size() ? (size_t)std::min<uint64_t>(length, data.size() - offset) : 0;
+    if (got)
+        memcpy(buf, data.data() + offset, got);
+    order.splice(order.begin(), order, it->second.pos);
+    return true;
+}
+
+bool HeadCache::contains(int id, uint64_t version) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it = heads.find(id);
+    return it != heads.end() && it->second.version == version;
+}
+
+void HeadCache::put(int id, uint64_t version, std::string data)
+{
+    if (data.size() > m_headSize)
+        data.resize(m_headSize);
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it = heads.find(id);
+    if (it != heads.end())
+        erase(it);
+    m_bytes += data.size();
+    order.push_front(id);
+    heads[id] = { version, std::move(data), order.begin() };
+    while (m_bytes > m_capacity && !order.empty())
+        erase(heads.find(order.back()));
+}
+
+void HeadCache::remove(int id)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    auto it = heads.find(id);
+    if (it != heads.end())
+        erase(it);
+}
+
+// m_mutex must be held
+void HeadCache::erase(std::unordered_map<int, Head>::iterator it)
+{
+    m_bytes -= it->second.data.size();
+    order.erase(it->second.pos);
+    heads.erase(it);
+}
+
+bool HeadCache::save(const std::string& file) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    uint64_t headSize = m_headSize, count = heads.size();
+    out.write(HEADS_MAGIC, 4);
+    out.write((const char*)&headSize, sizeof(headSize));
+    out.write((const char*)&count, sizeof(count));
+    // least recently used first, so loading in file order restores the order
+    for (auto it = order.rbegin(); it != order.rend(); ++it)
+    {
+        const Head& h = heads.at(*it);
+        int32_t id = *it;
+        uint32_t size = (uint32_t)h.data.size();
+        out.write((const char*)&id, sizeof(id));
+        out.write((const char*)&h.version, sizeof(h.version));
+        out.write((const char*)&size, sizeof(size));
+        out.write(h.data.data(), size);
+    }
+    return (bool)out;
+}
+
+bool HeadCache::load(const std::string& file)
+{
+    std::ifstream in(file, std::ios::binary);
+    if (!in)
+        return false;
+    char magic[4];
+    uint64_t headSize = 0, count = 0;
+    in.read(magic, 4);
+    in.read((char*)&headSize, sizeof(headSize));
+    in.read((char*)&count, sizeof(count));
+    // heads of another size would claim to be whole files
+    if (!in || memcmp(magic, HEADS_MAGIC, 4) != 0 || headSize != m_headSize)
+        return false;
+    for (uint64_t i = 0; i < count; i++)
+    {
+        int32_t id;
+        uint64_t version;
+        uint32_t size;
+        in.read((char*)&id, sizeof(id));
+        in.read((char*)&version, sizeof(version));
+        in.read((char*)&size, sizeof(size));
+        if (!in || size > m_headSize)
+            return false;
+        std::string data(size, '\0');
+        in.read(&data[0], size);
+        if (!in)
+            return false;
+        put(id, version, std::move(data));
+    }
+    return true;
+}
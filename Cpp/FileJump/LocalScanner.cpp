@@ -0,0 +1,220 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "LocalScanner.h"
+#include "CUrlTools.h"
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <condition_variable>
+
+std::string LocalSnapshot::dirPath(uint32_t dir) const
+{
+    std::vector<uint32_t> chain;
+    for (uint32_t d = dir; d != 0 && d != NO_PARENT; d = dirs[d].parent)
+        chain.push_back(d);
+    std::string out;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+    {
+        if (!out.empty())
+            out += '/';
+        out += name(dirs[*it]);
+    }
+    return out;
+}
+
+LocalScanner::LocalScanner(unsigned threads)
+    : m_threads(threads ? threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+namespace
+{
+    struct Job
+    {
+        uint32_t dir;
+        std::wstring path;
+    };
+
+    struct Worker
+    {
+        std::mutex m_mutex;
+        std::deque<Job> jobs;       // own jobs are taken from the back, stolen ones from the front
+        std::vector<std::pair<uint32_t, LocalSnapshot::Dir>> dirs;
+        std::vector<LocalSnapshot::File> files;
+        std::string names;
+        uint64_t errors = 0;
+
+        void push(Job&& job)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            jobs.push_back(std::move(job));
+        }
+        bool pop(Job& job)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (jobs.empty())
+                return false;
+            job = std::move(jobs.back());
+            jobs.pop_back();
+            return true;
+        }
+        bool steal(Job& job)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (jobs.empty())
+                return false;
+            job = std::move(jobs.front());
+            jobs.pop_front();
+            return true;
+        }
+        uint32_t addName(const wchar_t* name)
+        {
+            uint32_t offset = (uint32_t)names.size();
+            names += CUrlTools::WideToUtf8(name);
+            return offset;
+        }
+    };
+}
+
+bool LocalScanner::scan(const std::string& root, LocalSnapshot& snapshot)
+{
+    snapshot = LocalSnapshot();
+    // Long path form, so deep trees are not limited by MAX_PATH
+    std::wstring rootPath = CUrlTools::Utf8ToWide(root);
+    std::vector<wchar_t> full(32768);
+    DWORD n = GetFullPathNameW(rootPath.c_str(), (DWORD)full.size(), full.data(), nullptr);
+    if (n > 0 && n < full.size())
+        rootPath = full[0] == L'\\' ? std::wstring(full.data()) : std::wstring(L"\\\\?\\") + full.data();
+    while (!rootPath.empty() && (rootPath.back() == L'\\' || rootPath.back() == L'/'))
+        rootPath.pop_back();
+    DWORD attributes = GetFileAttributesW((rootPath + L"\\").c_str());
+    if (attributes == INVALID_FILE_ATTRIBUTES || !(attributes & FILE_ATTRIBUTE_DIRECTORY))
+        return false;
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < m_threads; i++)
+        workers.emplace_back(new Worker());
+    std::atomic<uint32_t> nextDir{ 1 };
+    std::atomic<uint64_t> pending{ 1 };     // folders queued or being listed
+    std::mutex waitMutex;
+    std::condition_variable wake;           // folders were queued or the scan ended
+    auto idle = [&]
+    {
+        std::unique_lock<std::mutex> lock(waitMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(20));
+    };
+    workers[0]->push({ 0, rootPath });
+
+    auto list = [&](Worker& w, const Job& job)
+    {
+        WIN32_FIND_DATAW fd;
+        HANDLE h = FindFirstFileExW((job.path + L"\\*").c_str(), FindExInfoBasic, &fd, FindExSearchNameMatch,
+            nullptr, FIND_FIRST_EX_LARGE_FETCH);
+        if (h == INVALID_HANDLE_VALUE)
+        {
+            w.errors++;
+            return;
+        }
+        do
+        {
+            if (fd.cFileName[0] == L'.' && (fd.cFileName[1] == 0 || (fd.cFileName[1] == L'.' && fd.cFileName[2] == 0)))
+                continue;
+            // linked folders (junctions, symbolic links) are not followed; files that are reparse
+            // points (cloud placeholders, deduplicated files, file links) are listed like any file
+            if ((fd.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) && (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+                continue;
+            uint32_t offset = w.addName(fd.cFileName);
+            uint32_t length = (uint32_t)w.names.size() - offset;
+            if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                uint32_t id = nextDir++;
+                w.dirs.push_back({ id, { job.dir, offset, length } });
+                pending++;
+                w.push({ id, job.path + L"\\" + fd.cFileName });
+            }
+            else
+            {
+                ULARGE_INTEGER size;
+                size.LowPart = fd.nFileSizeLow;
+                size.HighPart = fd.nFileSizeHigh;
+                w.files.push_back({ job.dir, offset, length, size.QuadPart, fd.ftCreationTime, fd.ftLastWriteTime });
+            }
+        } while (FindNextFileW(h, &fd));
+        FindClose(h);
+    };
+
+    auto run = [&](unsigned self)
+    {
+        Worker& w = *workers[self];
+        Job job;
+        while (pending > 0)
+        {
+            bool found = w.pop(job);
+            for (unsigned i = 1; !found && i < workers.size(); i++)
+                found = workers[(self + i) % workers.size()]->steal(job);
+            if (!found)
+            {
+                idle();
+                continue;
+            }
+            size_t queued = w.dirs.size();
+            list(w, job);
+            if (--pending == 0 || w.dirs.size() != queued)
+                wake.notify_all();
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < m_threads; i++)
+        threads.emplace_back(run, i);
+    run(0);
+    for (auto& t : threads)
+        t.join();
+
+    // Merge the per-worker results; folder ids are their indexes
+    snapshot.dirs.resize(nextDir);
+    snapshot.dirs[0] = { LocalSnapshot::NO_PARENT, 0, 0 };
+    for (auto& w : workers)
+    {
+        uint32_t base = (uint32_t)snapshot.names.size();
+        snapshot.names += w->names;
+        for (auto& d : w->dirs)
+        {
+            snapshot.dirs[d.first] = d.second;
+            snapshot.dirs[d.first].nameOffset += base;
+        }
+        for (auto& f : w->files)
+        {
+            snapshot.files.push_back(f);
+            snapshot.files.back().nameOffset += base;
+        }
+        snapshot.errors += w->errors;
+    }
+    return snapshot.errors == 0 || snapshot.dirs.size() > 1 || !snapshot.files.empty();
+}
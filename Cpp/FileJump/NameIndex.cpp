@@ -0,0 +1,555 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "NameIndex.h"
+#include "FJAccess.h"
+#include "CUrlTools.h"
+#include <windows.h>
+#include <emmintrin.h>
+#include <algorithm>
+#include <fstream>
+#include <regex>
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace
+{
+    inline unsigned lowestBit(unsigned mask)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return (unsigned)index;
+#else
+        return (unsigned)__builtin_ctz(mask);
+#endif
+    }
+
+    // ASCII case folding; bytes of multi-byte UTF-8 sequences are left as they are
+    std::string fold(const std::string& s)
+    {
+        std::string out = s;
+        for (auto& c : out)
+            if (c >= 'A' && c <= 'Z')
+                c = (char)(c - 'A' + 'a');
+        return out;
+    }
+
+    uint64_t ticks(const FILETIME& ft)
+    {
+        return ((uint64_t)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+    }
+
+    bool parseSize(const std::string& s, uint64_t& out)
+    {
+        char* end = nullptr;
+        double v = strtod(s.c_str(), &end);
+        if (end == s.c_str() || v < 0)
+            return false;
+        switch (toupper((unsigned char)*end))
+        {
+        case 0:   break;
+        case 'K': v *= 1024.0; end++; break;
+        case 'M': v *= 1024.0 * 1024; end++; break;
+        case 'G': v *= 1024.0 * 1024 * 1024; end++; break;
+        case 'T': v *= 1024.0 * 1024 * 1024 * 1024; end++; break;
+        default:  return false;
+        }
+        if (*end == 'B' || *end == 'b')
+            end++;
+        if (*end)
+            return false;
+        out = (uint64_t)v;
+        return true;
+    }
+
+    // "YYYY-MM-DD" or "YYYY-MM-DDTHH:MM:SS", UTC
+    bool parseDate(const std::string& s, uint64_t& out)
+    {
+        SYSTEMTIME st = {};
+        int y = 0, mo = 0, d = 0, h = 0, mi = 0, sec = 0;
+        int n = sscanf(s.c_str(), "%d-%d-%d%*[T ]%d:%d:%d", &y, &mo, &d, &h, &mi, &sec);
+        if (n != 3 && n != 6)
+            return false;
+        st.wYear = (WORD)y;
+        st.wMonth = (WORD)mo;
+        st.wDay = (WORD)d;
+        st.wHour = (WORD)h;
+        st.wMinute = (WORD)mi;
+        st.wSecond = (WORD)sec;
+        FILETIME ft;
+        if (!SystemTimeToFileTime(&st, &ft))
+            return false;
+        out = ticks(ft);
+        return true;
+    }
+
+    std::string percentDecode(const std::string& s)
+    {
+        std::string out;
+        for (size_t i = 0; i < s.size(); i++)
+        {
+            if (s[i] == '%' && i + 2 < s.size() && isxdigit((unsigned char)s[i + 1]) && isxdigit((unsigned char)s[i + 2]))
+            {
+                out += (char)std::stoi(s.substr(i + 1, 2), nullptr, 16);
+                i += 2;
+            }
+            else
+                out += s[i];
+        }
+        return out;
+    }
+}
+
+bool NameIndex::Query::parse(const std::string& text, Query& query)
+{
+    query = Query();
+    if (text.find('=') == std::string::npos)
+    {
+        query.text = percentDecode(text);
+        return !query.text.empty();
+    }
+    size_t pos = 0;
+    while (pos <= text.size())
+    {
+        size_t end = text.find('&', pos);
+        if (end == std::string::npos)
+            end = text.size();
+        std::string part = text.substr(pos, end - pos);
+        pos = end + 1;
+        if (part.empty())
+            continue;
+        size_t eq = part.find('=');
+        if (eq == std::string::npos)
+            return false;
+        std::string key = fold(part.substr(0, eq));
+        std::string value = percentDecode(part.substr(eq + 1));
+        bool ok = true;
+        if (key == "text")
+            query.text = value;
+        else if (key == "name")
+            query.glob = value;
+        else if (key == "regex")
+            query.regex = value;
+        else if (key == "prefix")
+            query.prefix = value;
+        else if (key == "minsize")
+            ok = parseSize(value, query.minSize);
+        else if (key == "maxsize")
+            ok = parseSize(value, query.maxSize);
+        else if (key == "after")
+            ok = parseDate(value, query.after);
+        else if (key == "before")
+            ok = parseDate(value, query.before);
+        else if (key == "type")
+        {
+            query.type = value == "file" ? 1 : value == "dir" ? 2 : -1;
+            ok = query.type >= 0;
+        }
+        else if (key == "limit")
+        {
+            uint64_t limit = 0;
+            ok = parseSize(value, limit) && limit > 0;
+            query.limit = (size_t)limit;
+        }
+        else
+            ok = false;
+        if (!ok)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * @details Classic SSE2 search: compare 16 positions at a time against the first and the last
+ *          byte of the needle and check the middle only where both match.
+ */
+void NameIndex::findAll(const std::string& haystack, const std::string& needle, const std::function<bool(size_t)>& found)
+{
+    size_t n = needle.size();
+    size_t size = haystack.size();
+    if (n == 0 || n > size)
+        return;
+    const char* h = haystack.data();
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[n - 1]);
+    size_t i = 0;
+    for (; i + n - 1 + 16 <= size; i += 16)
+    {
+        __m128i a = _mm_loadu_si128((const __m128i*)(h + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(h + i + n - 1));
+        unsigned mask = (unsigned)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last)));
+        while (mask)
+        {
+            unsigned bit = lowestBit(mask);
+            if (n <= 2 || memcmp(h + i + bit + 1, needle.data() + 1, n - 2) == 0)
+                if (!found(i + bit))
+                    return;
+            mask &= mask - 1;
+        }
+    }
+    for (; i + n <= size; i++)
+        if (h[i] == needle[0] && memcmp(h + i, needle.data(), n) == 0)
+            if (!found(i))
+                return;
+}
+
+bool NameIndex::globMatch(const char* name, size_t nameLength, const char* pattern, size_t patternLength)
+{
+    size_t n = 0, p = 0;
+    size_t starP = std::string::npos, starN = 0;
+    while (n < nameLength)
+    {
+        if (p < patternLength && (pattern[p] == '?' || pattern[p] == name[n]))
+        {
+            n++;
+            p++;
+        }
+        else if (p < patternLength && pattern[p] == '*')
+        {
+            starP = p++;
+            starN = n;
+        }
+        else if (starP != std::string::npos)
+        {
+            p = starP + 1;
+            n = ++starN;
+        }
+        else
+            return false;
+    }
+    while (p < patternLength && pattern[p] == '*')
+        p++;
+    return p == patternLength;
+}
+
+void NameIndex::clear()
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    records.clear();
+    byId.clear();
+    names.assign(1, '\0');
+    folded.assign(1, '\0');
+    removed = 0;
+}
+
+size_t NameIndex::size() const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return byId.size();
+}
+
+void NameIndex::append(const Record& r, const std::string& name)
+{
+    if (names.empty())
+    {
+        names.assign(1, '\0');
+        folded.assign(1, '\0');
+    }
+    Record rec = r;
+    rec.nameOffset = (uint32_t)names.size();
+    rec.nameLength = (uint32_t)name.size();
+    names += name;
+    names += '\0';
+    folded += fold(name);
+    folded += '\0';
+    byId[rec.id] = (uint32_t)records.size();
+    records.push_back(rec);
+}
+
+void NameIndex::add(const FileInfo& fi)
+{
+    if (fi.id < 0)
+        return;
+    Record r = { 0, 0, fi.id, fi.parent_id > 0 ? fi.parent_id : 0, fi.size, ticks(fi.created_at), ticks(fi.updated_at), fi.isDir };
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto it = byId.find(fi.id);
+    if (it != byId.end())
+    {
+        Record& old = records[it->second];
+        if (names.compare(old.nameOffset, old.nameLength, fi.name) == 0)
+        {
+            r.nameOffset = old.nameOffset;
+            r.nameLength = old.nameLength;
+            old = r;
+            return;
+        }
+        old.id = -1;    // renamed: the name is appended again
+        removed++;
+    }
+    append(r, fi.name);
+    if (removed > records.size() / 2 && removed > 1000)
+        compact();
+}
+
+void NameIndex::remove(int id)
+{
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto it = byId.find(id);
+    if (it == byId.end())
+        return;
+    // a folder takes its subtree along; found before anything is dropped, under() walks byId
+    std::vector<uint32_t> drop = { it->second };
+    if (records[it->second].isDir && id > 0)
+        for (uint32_t i = 0; i < records.size(); i++)
+            if (records[i].id >= 0 && records[i].id != id && under(records[i], id))
+                drop.push_back(i);
+    for (uint32_t i : drop)
+    {
+        byId.erase(records[i].id);
+        records[i].id = -1;
+        removed++;
+    }
+    if (removed > records.size() / 2 && removed > 1000)
+        compact();
+}
+
+void NameIndex::compact()
+{
+    std::vector<Record> old;
+    old.swap(records);
+    std::string oldNames;
+    oldNames.swap(names);
+    folded.clear();
+    byId.clear();
+    removed = 0;
+    for (auto& r : old)
+        if (r.id >= 0)
+            append(r, oldNames.substr(r.nameOffset, r.nameLength));
+}
+
+std::string NameIndex::path(const Record& r) const
+{
+    std::vector<const Record*> chain = { &r };
+    for (int parent = r.parent; parent > 0 && chain.size() < 1000; )
+    {
+        auto it = byId.find(parent);
+        if (it == byId.end())
+            break;
+        chain.push_back(&records[it->second]);
+        parent = records[it->second].parent;
+    }
+    std::string out;
+    for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+    {
+        out += '/';
+        out.append(names, (*it)->nameOffset, (*it)->nameLength);
+    }
+    return out;
+}
+
+bool NameIndex::under(const Record& r, int folderId) const
+{
+    if (folderId == 0)
+        return true;
+    for (int parent = r.parent, depth = 0; parent > 0 && depth < 1000; depth++)
+    {
+        if (parent == folderId)
+            return true;
+        auto it = byId.find(parent);
+        if (it == byId.end())
+            return false;
+        parent = records[it->second].parent;
+    }
+    return false;
+}
+
+/**
+ * @return id of the folder with the given path, 0 for the root, -1 when not found
+ */
+int NameIndex::findFolder(const std::string& path) const
+{
+    int id = 0;
+    for (auto& part : CUrlTools::splitPath(path))
+    {
+        if (part.empty())
+            continue;
+        int next = -1;
+        findAll(folded, std::string(1, '\0') + fold(part) + '\0', [&](size_t pos)
+            {
+                auto it = std::upper_bound(records.begin(), records.end(), (uint32_t)(pos + 1),
+                    [](uint32_t offset, const Record& r) { return offset < r.nameOffset; });
+                const Record& r = *(it - 1);
+                if (r.id >= 0 && r.isDir && r.parent == id)
+                {
+                    next = r.id;
+                    return false;
+                }
+                return true;
+            });
+        if (next < 0)
+            return -1;
+        id = next;
+    }
+    return id;
+}
+
+std::vector<NameIndex::Match> NameIndex::search(const Query& query) const
+{
+    std::vector<Match> out;
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+    std::regex re;
+    if (!query.regex.empty())
+    {
+        try
+        {
+            re = std::regex(query.regex, std::regex::ECMAScript | std::regex::icase);
+        }
+        catch (const std::regex_error&)
+        {
+            return out;
+        }
+    }
+    int prefixId = 0;
+    if (!query.prefix.empty())
+    {
+        prefixId = findFolder(query.prefix);
+        if (prefixId < 0)
+            return out;
+    }
+    std::string text = fold(query.text);
+    std::string glob = fold(query.glob);
+
+    // The substring scanned for: the text, or the longest literal run of the glob
+    std::string scan = text;
+    if (scan.empty() && !glob.empty())
+    {
+        size_t start = 0;
+        while (start < glob.size())
+        {
+            size_t end = glob.find_first_of("*?", start);
+            if (end == std::string::npos)
+                end = glob.size();
+            if (end - start > scan.size())
+                scan = glob.substr(start, end - start);
+            start = end + 1;
+        }
+    }
+
+    auto consider = [&](const Record& r)
+    {
+        if (r.id < 0 || r.size < query.minSize || r.size > query.maxSize ||
+            r.modified < query.after || r.modified >= query.before ||
+            (query.type == 1 && r.isDir) || (query.type == 2 && !r.isDir))
+            return true;
+        const char* name = folded.data() + r.nameOffset;
+        if (!text.empty() && scan != text && std::string(name, r.nameLength).find(text) == std::string::npos)
+            return true;
+        if (!glob.empty() && !globMatch(name, r.nameLength, glob.data(), glob.size()))
+            return true;
+        std::string original = names.substr(r.nameOffset, r.nameLength);
+        if (!query.regex.empty() && !std::regex_search(original, re))
+            return true;
+        if (prefixId && !under(r, prefixId))
+            return true;
+        out.push_back({ path(r), original, r.id, r.parent, r.size, r.created, r.modified, r.isDir });
+        return out.size() < query.limit;
+    };
+
+    if (scan.empty())
+    {
+        for (auto& r : records)
+            if (!consider(r))
+                break;
+        return out;
+    }
+    const Record* last = nullptr;
+    findAll(folded, scan, [&](size_t pos)
+        {
+            auto it = std::upper_bound(records.begin(), records.end(), (uint32_t)pos,
+                [](uint32_t offset, const Record& r) { return offset < r.nameOffset; });
+            const Record* r = &*(it - 1);
+            if (r == last)
+                return true;
+            last = r;
+            return consider(*r);
+        });
+    return out;
+}
+
+namespace
+{
+    const char INDEX_MAGIC[4] = { 'F', 'J', 'N', 'I' };
+}
+
+bool NameIndex::save(const std::string& file) const
+{
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    std::ofstream out(file, std::ios::binary | std::ios::trunc);
+    if (!out)
+        return false;
+    uint32_t recordSize = sizeof(Record);
+    uint64_t count = records.size(), namesSize = names.size();
+    out.write(INDEX_MAGIC, 4);
+    out.write((const char*)&recordSize, sizeof(recordSize));
+    out.write((const char*)&count, sizeof(count));
+    out.write((const char*)&namesSize, sizeof(namesSize));
+    out.write(names.data(), names.size());
+    out.write((const char*)records.data(), records.size() * sizeof(Record));
+    return (bool)out;
+}
+
+bool NameIndex::load(const std::string& file)
+{
+    std::ifstream in(file, std::ios::binary | std::ios::ate);
+    if (!in)
+        return false;
+    uint64_t fileSize = (uint64_t)in.tellg();
+    in.seekg(0);
+    char magic[4];
+    uint32_t recordSize = 0;
+    uint64_t count = 0, namesSize = 0;
+    in.read(magic, 4);
+    in.read((char*)&recordSize, sizeof(recordSize));
+    in.read((char*)&count, sizeof(count));
+    in.read((char*)&namesSize, sizeof(namesSize));
+    if (!in || memcmp(magic, INDEX_MAGIC, 4) != 0 || recordSize != sizeof(Record) || namesSize > UINT32_MAX)
+        return false;
+    // a damaged header must not size the buffers: names and records have to fit in the file;
+    // false makes the caller build the index again
+    uint64_t header = 4 + sizeof(recordSize) + sizeof(count) + sizeof(namesSize);
+    if (namesSize > fileSize - header || count > (fileSize - header - namesSize) / sizeof(Record))
+        return false;
+    std::string loadedNames(namesSize, '\0');
+    std::vector<Record> loaded(count);
+    in.read(&loadedNames[0], namesSize);
+    in.read((char*)loaded.data(), count * sizeof(Record));
+    if (!in)
+        return false;
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    records.clear();
+    byId.clear();
+    names.assign(1, '\0');
+    folded.assign(1, '\0');
+    removed = 0;
+    for (auto& r : loaded)
+        if (r.id >= 0 && (uint64_t)r.nameOffset + r.nameLength <= namesSize)
+            append(r, loadedNames.substr(r.nameOffset, r.nameLength));
+    return true;
+}
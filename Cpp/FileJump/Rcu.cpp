@@ -0,0 +1,125 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "Rcu.h"
+#include <cstdint>
+
+namespace
+{
+    const size_t SLOTS = 256;
+
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch{ 0 };       // 0 = no guard alive on the owning thread
+        std::atomic<bool> used{ false };
+    };
+
+    Slot slots[SLOTS];
+    std::atomic<uint64_t> globalEpoch{ 1 };
+    std::atomic<uint64_t> unslotted{ 0 };       // guards of threads that found no free slot
+    std::mutex retiredMutex;
+    std::vector<std::pair<uint64_t, std::function<void()>>> retired;
+
+    struct ThreadSlot
+    {
+        Slot* slot = nullptr;
+        unsigned depth = 0;
+
+        ThreadSlot()
+        {
+            for (auto& s : slots)
+            {
+                bool expected = false;
+                if (s.used.compare_exchange_strong(expected, true))
+                {
+                    slot = &s;
+                    break;
+                }
+            }
+        }
+        ~ThreadSlot()
+        {
+            if (slot)
+            {
+                slot->epoch = 0;
+                slot->used = false;
+            }
+        }
+    };
+
+    thread_local ThreadSlot self;
+}
+
+Epoch::Guard::Guard()
+{
+    if (!self.slot)
+        unslotted++;
+    else if (self.depth++ == 0)
+        self.slot->epoch = globalEpoch.load();
+}
+
+Epoch::Guard::~Guard()
+{
+    if (!self.slot)
+        unslotted--;
+    else if (--self.depth == 0)
+        self.slot->epoch = 0;
+}
+
+/**
+ * @details A reader that can still see the retired data entered its guard before the data was
+ *          unpublished, so it holds an epoch not above the one recorded here; the data is freed
+ *          when every live guard holds a later epoch.
+ */
+void Epoch::retire(std::function<void()> free)
+{
+    uint64_t retiredAt = globalEpoch.fetch_add(1);
+    std::vector<std::function<void()>> ready;
+    {
+        std::lock_guard<std::mutex> guard(retiredMutex);
+        retired.emplace_back(retiredAt, std::move(free));
+
+        uint64_t oldest = UINT64_MAX;
+        if (unslotted > 0)
+            oldest = 0;
+        for (auto& s : slots)
+        {
+            uint64_t e = s.epoch;
+            if (e && e < oldest)
+                oldest = e;
+        }
+        size_t kept = 0;
+        for (auto& r : retired)
+        {
+            if (r.first < oldest)
+                ready.push_back(std::move(r.second));
+            else
+                retired[kept++] = std::move(r);
+        }
+        retired.resize(kept);
+    }
+    for (auto& f : ready)
+        f();
+}
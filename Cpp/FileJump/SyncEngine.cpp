@@ -0,0 +1,406 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "SyncEngine.h"
+#include "FJAccess.h"
+#include "TaskPool.h"
+#include "CUrlTools.h"
+#include "LocalScanner.h"
+#include <windows.h>
+#include <bcrypt.h>
+#include <fstream>
+#include <algorithm>
+#include <cctype>
+#include <unordered_map>
+
+#pragma comment(lib, "bcrypt.lib")
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    bool localTimes(const fs::path& path, FILETIME& created, FILETIME& modified)
+    {
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(path.wstring().c_str(), GetFileExInfoStandard, &data))
+            return false;
+        created = data.ftCreationTime;
+        modified = data.ftLastWriteTime;
+        return true;
+    }
+
+    // Local time formatted like Python's str(datetime.fromtimestamp(t)), as in the descriptions FjOperations writes
+    std::string localTimeString(const FILETIME& ft)
+    {
+        SYSTEMTIME utc, local;
+        if (!FileTimeToSystemTime(&ft, &utc) || !SystemTimeToTzSpecificLocalTime(nullptr, &utc, &local))
+            return {};
+        ULARGE_INTEGER ticks;
+        ticks.LowPart = ft.dwLowDateTime;
+        ticks.HighPart = ft.dwHighDateTime;
+        unsigned us = (unsigned)((ticks.QuadPart / 10) % 1000000);
+        char buf[40];
+        int n = snprintf(buf, sizeof(buf), "%04u-%02u-%02u %02u:%02u:%02u", local.wYear, local.wMonth, local.wDay,
+            local.wHour, local.wMinute, local.wSecond);
+        if (us)
+            snprintf(buf + n, sizeof(buf) - n, ".%06u", us);
+        return buf;
+    }
+}
+
+SyncEngine::SyncEngine(FJAccess* access)
+    : m_access(access)
+{
+}
+
+std::string SyncEngine::fileSha256(const fs::path& path)
+{
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+        return {};
+    BCRYPT_HASH_HANDLE hash = nullptr;
+    if (!BCRYPT_SUCCESS(BCryptCreateHash(BCRYPT_SHA256_ALG_HANDLE, &hash, nullptr, 0, nullptr, 0, 0)))
+        return {};
+    std::vector<char> buf(1024 * 1024);
+    bool ok = true;
+    while (ok && in)
+    {
+        in.read(buf.data(), buf.size());
+        if (in.gcount() > 0)
+            ok = BCRYPT_SUCCESS(BCryptHashData(hash, (PUCHAR)buf.data(), (ULONG)in.gcount(), 0));
+    }
+    unsigned char digest[32];
+    ok = ok && in.eof() && BCRYPT_SUCCESS(BCryptFinishHash(hash, digest, sizeof(digest), 0));
+    BCryptDestroyHash(hash);
+    if (!ok)
+        return {};
+    static const char hex[] = "0123456789abcdef";
+    std::string out(64, '0');
+    for (int i = 0; i < 32; i++)
+    {
+        out[2 * i] = hex[digest[i] >> 4];
+        out[2 * i + 1] = hex[digest[i] & 15];
+    }
+    return out;
+}
+
+std::string SyncEngine::describe(const fs::path& local, const std::string& sha256)
+{
+    FILETIME created, modified;
+    json j;
+    j["SHA256"] = sha256;
+    if (localTimes(local, created, modified))
+    {
+        j["ctime"] = localTimeString(created);
+        j["utime"] = localTimeString(modified);
+    }
+    return j.dump();
+}
+
+/**
+ * @brief Function returns the remote name of a local folder
+ * @details FileJump rejects folder names shorter than 3 characters; they are padded with '_' like FjOperations does.
+ */
+std::string SyncEngine::folderName(const std::string& name)
+{
+    std::string out = name;
+    if (out.size() < 3)
+        out.append(3 - out.size(), '_');
+    return out;
+}
+
+int SyncEngine::resolveFolder(const std::string& remotePath, bool create)
+{
+    int id = 0;
+    for (auto& part : CUrlTools::splitPath(remotePath))
+    {
+        if (part.empty())
+            continue;
+        std::string name = folderName(part);
+        int found = -1;
+        for (auto& fi : m_access->getDirectoryContent(id))
+            if (fi.isDir && fi.name == name)
+            {
+                found = fi.id;
+                break;
+            }
+        if (found < 0)
+        {
+            FileInfo created;
+            if (!create || !m_access->createDir(id, name, &created) || created.id < 0)
+                return -1;
+            found = created.id;
+        }
+        id = found;
+    }
+    return id;
+}
+
+void SyncEngine::report(Context& ctx, Action action, const std::string& path)
+{
+    if (!ctx.progress)
+        return;
+    std::lock_guard<std::mutex> guard(ctx.progressMutex);
+    ctx.progress(action, path);
+}
+
+/**
+ * @brief Function uploads one file, replacing the old remote entry
+ * @details The old entry is deleted only after the new content was uploaded, so a failed upload keeps it
+ * @param old the remote entry with the same name, id -1 when there is none
+ * @param verify upload only when the SHA-256 differs from the one in the description of old
+ */
+void SyncEngine::uploadTask(const fs::path& local, const std::string& rel, int remoteId, const FileInfo& old, bool verify, Context& ctx)
+{
+    std::string sha256 = fileSha256(local);
+    if (sha256.empty())
+    {
+        ctx.counters.failed++;
+        report(ctx, Action::Fail, rel);
+        return;
+    }
+    if (verify)
+    {
+        json desc = json::parse(old.description, nullptr, false);
+        std::string remoteSha256 = desc.is_object() ? desc.value("SHA256", "") : "";
+        std::transform(remoteSha256.begin(), remoteSha256.end(), remoteSha256.begin(), ::tolower);
+        if (remoteSha256 == sha256)
+        {
+            ctx.counters.skipped++;
+            report(ctx, Action::Skip, rel);
+            return;
+        }
+    }
+    if (!ctx.options.dryRun)
+    {
+        FileInfo uploaded;
+        if (!m_access->uploadFile(local.string(), remoteId, local.filename().u8string(), &uploaded, describe(local, sha256)))
+        {
+            ctx.counters.failed++;
+            report(ctx, Action::Fail, rel);
+            return;
+        }
+        // the new entry sits next to the old one until it is deleted
+        if (old.id >= 0 && old.id != uploaded.id && !m_access->deleteFile(remoteId, old.id))
+        {
+            ctx.counters.failed++;
+            report(ctx, Action::Fail, rel);
+            return;
+        }
+    }
+    std::error_code ec;
+    ctx.counters.uploaded++;
+    ctx.counters.bytes += fs::file_size(local, ec);
+    report(ctx, old.id >= 0 ? Action::Replace : Action::Upload, rel);
+}
+
+/**
+ * @brief Function compares one local folder with one listing of its remote folder
+ * @param dir index of the folder in the local snapshot
+ * @param remoteId id of the remote folder, -1 for a folder that a dry run would create
+ */
+void SyncEngine::syncFolder(uint32_t dir, const std::string& rel, int remoteId, Context& ctx)
+{
+    std::unordered_map<std::string, FileInfo> remote;
+    std::vector<FileInfo> duplicates;
+    if (remoteId >= 0)
+        for (auto& fi : m_access->getDirectoryContent(remoteId))
+            if (!remote.emplace(fi.name, fi).second)
+                duplicates.push_back(fi);
+
+    const LocalSnapshot& snapshot = ctx.snapshot;
+    for (uint32_t sub : ctx.subdirs[dir])
+    {
+        std::string name = snapshot.name(snapshot.dirs[sub]);
+        std::string path = rel + "/" + name;
+        std::string remoteName = folderName(name);
+        int id = -1;
+        auto it = remote.find(remoteName);
+        if (it != remote.end() && it->second.isDir)
+        {
+            id = it->second.id;
+            remote.erase(it);
+        }
+        else
+        {
+            if (it != remote.end())
+            {
+                // A file with the name of the folder
+                if (!ctx.options.deleteExtra)
+                {
+                    ctx.counters.failed++;
+                    report(ctx, Action::Fail, path);
+                    continue;
+                }
+                if (!ctx.options.dryRun)
+                    m_access->deleteFile(remoteId, it->second.id);
+                remote.erase(it);
+            }
+            FileInfo created;
+            if (!ctx.options.dryRun && remoteId >= 0)
+            {
+                if (!m_access->createDir(remoteId, remoteName, &created) || created.id < 0)
+                {
+                    ctx.counters.failed++;
+                    report(ctx, Action::Fail, path);
+                    continue;
+                }
+                id = created.id;
+            }
+            ctx.counters.folders++;
+            report(ctx, Action::CreateFolder, path);
+        }
+        syncFolder(sub, path, id, ctx);
+    }
+
+    for (uint32_t index : ctx.files[dir])
+    {
+        const LocalSnapshot::File& local = snapshot.files[index];
+        std::string name = snapshot.name(local);
+        std::string path = rel + "/" + name;
+        ctx.counters.scanned++;
+        FileInfo old;
+        bool verify = false;
+        auto it = remote.find(name);
+        if (it != remote.end())
+        {
+            old = it->second;
+            remote.erase(it);
+            if (old.isDir)
+            {
+                ctx.counters.failed++;
+                report(ctx, Action::Fail, path);
+                continue;
+            }
+            if (old.size == local.size)
+            {
+                json desc = json::parse(old.description, nullptr, false);
+                bool same = false;
+                if (desc.is_object() && desc.contains("utime"))
+                {
+                    same = desc.value("utime", "") == localTimeString(local.modified);
+                    verify = !same && ctx.options.compareHash && desc.contains("SHA256");
+                }
+                else
+                    same = CompareFileTime(&old.updated_at, &local.modified) >= 0;
+                if (same)
+                {
+                    ctx.counters.skipped++;
+                    report(ctx, Action::Skip, path);
+                    continue;
+                }
+            }
+        }
+        fs::path file = ctx.root / fs::u8path(path.substr(1));
+        ctx.pool->submit([this, file, path, remoteId, old, verify, &ctx]
+            {
+                // a task of the pool must not throw
+                try
+                {
+                    uploadTask(file, path, remoteId, old, verify, ctx);
+                }
+                catch (...)
+                {
+                    ctx.counters.failed++;
+                    report(ctx, Action::Fail, path);
+                }
+            });
+    }
+
+    if (!ctx.options.deleteExtra || remoteId < 0)
+        return;
+    for (auto& entry : remote)
+        duplicates.push_back(entry.second);
+    for (auto& fi : duplicates)
+    {
+        std::string path = rel + "/" + fi.name;
+        int id = fi.id;
+        ctx.pool->submit([this, path, remoteId, id, &ctx]
+            {
+                bool deleted = true;
+                if (!ctx.options.dryRun)
+                {
+                    try
+                    {
+                        deleted = m_access->deleteFile(remoteId, id);
+                    }
+                    catch (...)
+                    {
+                        deleted = false;
+                    }
+                }
+                if (!deleted)
+                {
+                    ctx.counters.failed++;
+                    report(ctx, Action::Fail, path);
+                    return;
+                }
+                ctx.counters.deleted++;
+                report(ctx, Action::Delete, path);
+            });
+    }
+}
+
+bool SyncEngine::sync(const std::string& localDir, const std::string& remotePath, const SyncOptions& options,
+    SyncStats& stats, const Progress& progress)
+{
+    std::error_code ec;
+    if (!fs::is_directory(fs::u8path(localDir), ec))
+        return false;
+    int remoteId = resolveFolder(remotePath, !options.dryRun);
+    if (remoteId < 0 && !options.dryRun)
+        return false;
+
+    Context ctx;
+    ctx.options = options;
+    ctx.progress = progress;
+    ctx.root = fs::u8path(localDir);
+    LocalScanner scanner;
+    if (!scanner.scan(localDir, ctx.snapshot))
+        return false;
+    if (ctx.snapshot.errors)
+        ctx.counters.failed += ctx.snapshot.errors;
+    ctx.subdirs.resize(ctx.snapshot.dirs.size());
+    ctx.files.resize(ctx.snapshot.dirs.size());
+    for (uint32_t d = 1; d < ctx.snapshot.dirs.size(); d++)
+        ctx.subdirs[ctx.snapshot.dirs[d].parent].push_back(d);
+    for (uint32_t f = 0; f < ctx.snapshot.files.size(); f++)
+        ctx.files[ctx.snapshot.files[f].dir].push_back(f);
+    {
+        TaskPool pool(options.threads);
+        ctx.pool = &pool;
+        syncFolder(0, "", remoteId, ctx);
+        pool.wait();
+    }
+
+    stats.scanned = ctx.counters.scanned;
+    stats.uploaded = ctx.counters.uploaded;
+    stats.skipped = ctx.counters.skipped;
+    stats.folders = ctx.counters.folders;
+    stats.deleted = ctx.counters.deleted;
+    stats.failed = ctx.counters.failed;
+    stats.bytes = ctx.counters.bytes;
+    return stats.failed == 0;
+}
@@ -0,0 +1,199 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "TreeCrawler.h"
+#include "FJAccess.h"
+#include "Cancellation.h"
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <memory>
+#include <condition_variable>
+
+TreeCrawler::TreeCrawler(FJAccess* access, unsigned threads)
+    : m_access(access), m_threads(threads ? threads : 1)
+{
+}
+
+namespace
+{
+    struct Job
+    {
+        int id;
+        int attempts;
+    };
+
+    struct Worker
+    {
+        std::mutex m_mutex;
+        std::deque<Job> jobs;       // own jobs are taken from the back, stolen ones from the front
+
+        void push(const Job& job)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            jobs.push_back(job);
+        }
+        bool pop(Job& job)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (jobs.empty())
+                return false;
+            job = jobs.back();
+            jobs.pop_back();
+            return true;
+        }
+        bool steal(Job& job)
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (jobs.empty())
+                return false;
+            job = jobs.front();
+            jobs.pop_front();
+            return true;
+        }
+    };
+}
+
+bool TreeCrawler::crawl(int root, const OnFolder& onFolder, const OnProgress& onProgress)
+{
+    const int MAX_ATTEMPTS = 3;
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < m_threads; i++)
+        workers.emplace_back(new Worker());
+    std::atomic<uint64_t> pending{ 1 };     // folders queued or being listed
+    std::atomic<uint64_t> folders{ 0 }, entries{ 0 }, failed{ 0 };
+    std::atomic<unsigned> limit{ m_threads < 4 ? m_threads : 4 };
+    std::atomic<unsigned> inFlight{ 0 };
+    std::atomic<unsigned> successes{ 0 };
+    std::mutex callbackMutex;
+    std::mutex waitMutex;
+    std::condition_variable wake;           // a slot was freed or folders were queued
+    auto idle = [&]
+    {
+        std::unique_lock<std::mutex> lock(waitMutex);
+        wake.wait_for(lock, std::chrono::milliseconds(20));
+    };
+    auto lastProgress = std::chrono::steady_clock::now();
+    workers[0]->push({ root, 0 });
+
+    auto report = [&](bool force)
+    {
+        if (!onProgress)
+            return;
+        std::lock_guard<std::mutex> guard(callbackMutex);
+        auto now = std::chrono::steady_clock::now();
+        if (!force && now - lastProgress < std::chrono::milliseconds(500))
+            return;
+        lastProgress = now;
+        onProgress({ folders, entries, pending, failed, limit });
+    };
+
+    auto run = [&](unsigned self)
+    {
+        Worker& w = *workers[self];
+        Job job;
+        while (pending > 0 && !cancelled)
+        {
+            // Take a slot only while under the adaptive limit
+            unsigned current = inFlight;
+            if (current >= limit || !inFlight.compare_exchange_weak(current, current + 1))
+            {
+                if (current >= limit)
+                    idle();
+                continue;
+            }
+            bool found = w.pop(job);
+            for (unsigned i = 1; !found && i < workers.size(); i++)
+                found = workers[(self + i) % workers.size()]->steal(job);
+            if (!found)
+            {
+                inFlight--;
+                idle();
+                continue;
+            }
+
+            bool ok = true;
+            std::list<FileInfo> content = m_access->get_files(job.id, "", &ok);
+            inFlight--;
+            wake.notify_one();
+            if (!ok)
+            {
+                unsigned l = limit;
+                if (l > 1)
+                    limit.compare_exchange_strong(l, l / 2);
+                successes = 0;
+                if (++job.attempts < MAX_ATTEMPTS)
+                {
+                    w.push(job);
+                    std::this_thread::sleep_for(std::chrono::milliseconds(200 * job.attempts));
+                    continue;
+                }
+                failed++;
+                pending--;
+                continue;
+            }
+            if (++successes >= limit)
+            {
+                successes = 0;
+                unsigned l = limit;
+                if (l < m_threads)
+                    limit.compare_exchange_strong(l, l + 1);
+            }
+
+            for (auto& fi : content)
+            {
+                if (fi.isDir)
+                {
+                    pending++;
+                    w.push({ fi.id, 0 });
+                }
+            }
+            folders++;
+            entries += content.size();
+            if (onFolder)
+            {
+                std::lock_guard<std::mutex> guard(callbackMutex);
+                onFolder(job.id, content);
+            }
+            pending--;
+            wake.notify_all();
+            report(false);
+        }
+    };
+    std::vector<std::thread> threads;
+    for (unsigned i = 1; i < m_threads; i++)
+        threads.emplace_back(run, i);
+    {
+        // the crawl outlives the deadline of the operation that started it; only cancel() stops it
+        CancellationToken::Scope detached(nullptr);
+        run(0);
+    }
+    for (auto& t : threads)
+        t.join();
+    report(true);
+    return !cancelled && failed == 0;
+}
@@ -0,0 +1,563 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include "ZipStreamReader.h"
+#include <cstring>
+#include <array>
+
+namespace
+{
+    const uint32_t LOCAL_HEADER_SIG = 0x04034b50;
+    const uint32_t DATA_DESCRIPTOR_SIG = 0x08074b50;
+    const uint32_t CENTRAL_HEADER_SIG = 0x02014b50;
+    const uint32_t END_OF_CENTRAL_SIG = 0x06054b50;
+    const uint32_t ZIP64_END_OF_CENTRAL_SIG = 0x06064b50;
+    const uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+    const uint16_t METHOD_STORE = 0;
+    const uint16_t METHOD_DEFLATE = 8;
+
+    uint16_t read16(const std::string& b, size_t pos)
+    {
+        return (uint16_t)((unsigned char)b[pos] | ((unsigned char)b[pos + 1] << 8));
+    }
+    uint32_t read32(const std::string& b, size_t pos)
+    {
+        return (uint32_t)read16(b, pos) | ((uint32_t)read16(b, pos + 2) << 16);
+    }
+    uint64_t read64(const std::string& b, size_t pos)
+    {
+        return (uint64_t)read32(b, pos) | ((uint64_t)read32(b, pos + 4) << 32);
+    }
+
+    /**
+     * Raw deflate decoder, a straightforward port of the canonical decoder in
+     * zlib's contrib/puff. Speed is not a goal: it runs over entries of an
+     * archive that was just received from the network.
+     */
+    class Inflater
+    {
+    private:
+        static const int MAXBITS = 15;
+        struct Huffman
+        {
+            short count[MAXBITS + 1];   // number of symbols of each length
+            short symbol[288];          // canonically ordered symbols
+        };
+        struct OutOfInput {};
+
+        const unsigned char* m_in;
+        size_t m_inLen;
+        size_t m_inPos;
+        long m_bitBuf;
+        int m_bitCnt;
+        std::string& m_out;
+
+        int bits(int need)
+        {
+            long val = m_bitBuf;
+            while (m_bitCnt < need)
+            {
+                if (m_inPos == m_inLen)
+                    throw OutOfInput();
+                val |= (long)m_in[m_inPos++] << m_bitCnt;
+                m_bitCnt += 8;
+            }
+            m_bitBuf = val >> need;
+            m_bitCnt -= need;
+            return (int)(val & ((1L << need) - 1));
+        }
+
+        int stored()
+        {
+            // discard leftover bits of the current byte
+            m_bitBuf = 0;
+            m_bitCnt = 0;
+            if (m_inPos + 4 > m_inLen)
+                throw OutOfInput();
+            unsigned len = m_in[m_inPos] | (m_in[m_inPos + 1] << 8);
+            if (m_in[m_inPos + 2] != (~len & 0xff) || m_in[m_inPos + 3] != ((~len >> 8) & 0xff))
+                return -2;
+            m_inPos += 4;
+            if (m_inPos + len > m_inLen)
+                throw OutOfInput();
+            m_out.append((const char*)m_in + m_inPos, len);
+            m_inPos += len;
+            return 0;
+        }
+
+        int decode(const Huffman& h)
+        {
+            int code = 0, first = 0, index = 0;
+            for (int len = 1; len <= MAXBITS; len++)
+            {
+                code |= bits(1);
+                int count = h.count[len];
+                if (code - count < first)
+                    return h.symbol[index + (code - first)];
+                index += count;
+                first += count;
+                first <<= 1;
+                code <<= 1;
+            }
+            return -10;     // ran out of codes
+        }
+
+        static int construct(Huffman& h, const short* length, int n)
+        {
+            for (int len = 0; len <= MAXBITS; len++)
+                h.count[len] = 0;
+            for (int symbol = 0; symbol < n; symbol++)
+                h.count[length[symbol]]++;
+            if (h.count[0] == n)
+                return 0;   // no codes - complete, but decode() will fail
+            int left = 1;
+            for (int len = 1; len <= MAXBITS; len++)
+            {
+                left <<= 1;
+                left -= h.count[len];
+                if (left < 0)
+                    return left;    // over-subscribed
+            }
+            short offs[MAXBITS + 1];
+            offs[1] = 0;
+            for (int len = 1; len < MAXBITS; len++)
+                offs[len + 1] = offs[len] + h.count[len];
+            for (int symbol = 0; symbol < n; symbol++)
+                if (length[symbol] != 0)
+                    h.symbol[offs[length[symbol]]++] = (short)symbol;
+            return left;
+        }
+
+        int codes(const Huffman& lencode, const Huffman& distcode)
+        {
+            static const short lens[29] = {
+                3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+            static const short lext[29] = {
+                0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+            static const short dists[30] = {
+                1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145,
+                8193, 12289, 16385, 24577 };
+            static const short dext[30] = {
+                0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+            int symbol;
+            do
+            {
+                symbol = decode(lencode);
+                if (symbol < 0)
+                    return symbol;
+                if (symbol < 256)
+                    m_out.push_back((char)symbol);
+                else if (symbol > 256)
+                {
+                    symbol -= 257;
+                    if (symbol >= 29)
+                        return -10;
+                    size_t len = lens[symbol] + bits(lext[symbol]);
+                    symbol = decode(distcode);
+                    if (symbol < 0)
+                        return symbol;
+                    if (symbol >= 30)
+                        return -10;
+                    size_t dist = dists[symbol] + bits(dext[symbol]);
+                    if (dist > m_out.size())
+                        return -11;     // distance too far back
+                    size_t from = m_out.size() - dist;
+                    // byte by byte: source and destination may overlap
+                    for (size_t i = 0; i < len; i++)
+                        m_out.push_back(m_out[from + i]);
+                }
+            } while (symbol != 256);
+            return 0;
+        }
+
+        struct FixedCodes
+        {
+            Huffman lencode, distcode;
+            FixedCodes()
+            {
+                short lengths[288];
+                int symbol = 0;
+                for (; symbol < 144; symbol++) lengths[symbol] = 8;
+                for (; symbol < 256; symbol++) lengths[symbol] = 9;
+                for (; symbol < 280; symbol++) lengths[symbol] = 7;
+                for (; symbol < 288; symbol++) lengths[symbol] = 8;
+                construct(lencode, lengths, 288);
+                for (symbol = 0; symbol < 30; symbol++) lengths[symbol] = 5;
+                construct(distcode, lengths, 30);
+            }
+        };
+
+        int fixed()
+        {
+            // built by the first caller; the initialization of a local static is thread-safe
+            static const FixedCodes table;
+            return codes(table.lencode, table.distcode);
+        }
+
+        int dynamic()
+        {
+            static const short order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+            short lengths[286 + 30];
+            Huffman lencode, distcode;
+
+            int nlen = bits(5) + 257;
+            int ndist = bits(5) + 1;
+            int ncode = bits(4) + 4;
+            if (nlen > 286 || ndist > 30)
+                return -3;
+            int index = 0;
+            for (; index < ncode; index++)
+                lengths[order[index]] = (short)bits(3);
+            for (; index < 19; index++)
+                lengths[order[index]] = 0;
+            if (construct(lencode, lengths, 19) != 0)
+                return -4;      // code lengths code must be complete
+
+            index = 0;
+            while (index < nlen + ndist)
+            {
+                int symbol = decode(lencode);
+                if (symbol < 0)
+                    return symbol;
+                if (symbol < 16)
+                    lengths[index++] = (short)symbol;
+                else
+                {
+                    short len = 0;
+                    if (symbol == 16)
+                    {
+                        if (index == 0)
+                            return -5;  // no previous length to repeat
+                        len = lengths[index - 1];
+                        symbol = 3 + bits(2);
+                    }
+                    else if (symbol == 17)
+                        symbol = 3 + bits(3);
+                    else
+                        symbol = 11 + bits(7);
+                    if (index + symbol > nlen + ndist)
+                        return -6;
+                    while (symbol--)
+                        lengths[index++] = len;
+                }
+            }
+            if (lengths[256] == 0)
+                return -9;      // no end-of-block code
+            int err = construct(lencode, lengths, nlen);
+            if (err && (err < 0 || nlen != lencode.count[0] + lencode.count[1]))
+                return -7;      // incomplete code ok only for single length 1 code
+            err = construct(distcode, lengths + nlen, ndist);
+            if (err && (err < 0 || ndist != distcode.count[0] + distcode.count[1]))
+                return -8;
+            return codes(lencode, distcode);
+        }
+
+    public:
+        Inflater(const unsigned char* in, size_t inLen, std::string& out)
+            : m_in(in), m_inLen(inLen), m_inPos(0), m_bitBuf(0), m_bitCnt(0), m_out(out)
+        {
+        }
+
+        int run(size_t& consumed)
+        {
+            try
+            {
+                int last, err;
+                do
+                {
+                    last = bits(1);
+                    int type = bits(2);
+                    err = type == 0 ? stored() : (type == 1 ? fixed() : (type == 2 ? dynamic() : -1));
+                    if (err != 0)
+                        return err;
+                } while (!last);
+            }
+            catch (const OutOfInput&)
+            {
+                return 1;
+            }
+            consumed = m_inPos;
+            return 0;
+        }
+    };
+}
+
+FILEJUMP_API int ZipStreamReader::inflate(const char* data, size_t size, std::string& out, size_t& consumed)
+{
+    out.clear();
+    consumed = 0;
+    Inflater inflater((const unsigned char*)data, size, out);
+    return inflater.run(consumed);
+}
+
+FILEJUMP_API uint32_t ZipStreamReader::crc32(const char* data, size_t size, uint32_t crc)
+{
+    // built by the first caller; the initialization of a local static is thread-safe
+    static const std::array<uint32_t, 256> table = []
+        {
+            std::array<uint32_t, 256> t;
+            for (uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for (int k = 0; k < 8; k++)
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                t[n] = c;
+            }
+            return t;
+        }();
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ (unsigned char)data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+FILEJUMP_API ZipStreamReader::ZipStreamReader(EntryCallback onEntry)
+    : m_onEntry(onEntry), m_state(State::Header), m_finished(false),
+      m_flags(0), m_method(0), m_crc(0), m_compressedSize(0), m_size(0), m_zip64(false), m_ended(false), m_scanAt(0), m_retryAt(0)
+{
+}
+
+FILEJUMP_API bool ZipStreamReader::feed(const char* data, size_t size)
+{
+    if (m_state == State::Error)
+        return false;
+    if (m_state == State::Done)
+        return true;    // central directory is not needed
+    m_buffer.append(data, size);
+    return parse();
+}
+
+FILEJUMP_API bool ZipStreamReader::finish()
+{
+    if (m_state == State::Error)
+        return false;
+    m_ended = true;
+    return parse();
+}
+
+/**
+ * Unpacks every entry the buffered data completes.
+ * Returns false when the archive is corrupt or the callback asked to stop.
+ */
+bool ZipStreamReader::parse()
+{
+    bool progress = true;
+    while (progress)
+    {
+        progress = false;
+        if (m_state == State::Header)
+        {
+            if (!parseHeader())
+                break;
+            progress = m_state != State::Header;
+        }
+        else if (m_state == State::Data)
+        {
+            if (!parseData(progress))
+            {
+                m_state = State::Error;
+                return false;
+            }
+        }
+    }
+    return m_state != State::Error;
+}
+
+/**
+ * Parses a local file header (or recognises the central directory).
+ * Returns false when more data is needed or the archive is corrupt.
+ */
+bool ZipStreamReader::parseHeader()
+{
+    if (m_buffer.size() < 4)
+        return false;
+    uint32_t sig = read32(m_buffer, 0);
+    if (sig == CENTRAL_HEADER_SIG || sig == END_OF_CENTRAL_SIG || sig == ZIP64_END_OF_CENTRAL_SIG)
+    {
+        m_state = State::Done;
+        m_finished = true;
+        m_buffer.clear();
+        return false;
+    }
+    if (sig != LOCAL_HEADER_SIG)
+    {
+        m_state = State::Error;
+        return false;
+    }
+    if (m_buffer.size() < 30)
+        return false;
+    uint16_t nameLen = read16(m_buffer, 26);
+    uint16_t extraLen = read16(m_buffer, 28);
+    size_t headerLen = 30 + (size_t)nameLen + extraLen;
+    if (m_buffer.size() < headerLen)
+        return false;
+
+    m_flags = read16(m_buffer, 6);
+    m_method = read16(m_buffer, 8);
+    m_crc = read32(m_buffer, 14);
+    m_compressedSize = read32(m_buffer, 18);
+    m_size = read32(m_buffer, 22);
+    m_name = m_buffer.substr(30, nameLen);
+    m_zip64 = false;
+
+    // ZIP64 extended information: original size then compressed size, each present only when saturated
+    size_t pos = 30 + nameLen;
+    size_t extraEnd = pos + extraLen;
+    while (pos + 4 <= extraEnd)
+    {
+        uint16_t id = read16(m_buffer, pos);
+        uint16_t len = read16(m_buffer, pos + 2);
+        if (id == 0x0001)
+        {
+            m_zip64 = true;
+            size_t field = pos + 4;
+            if (m_size == 0xFFFFFFFF && field + 8 <= pos + 4 + len)
+            {
+                m_size = read64(m_buffer, field);
+                field += 8;
+            }
+            if (m_compressedSize == 0xFFFFFFFF && field + 8 <= pos + 4 + len)
+                m_compressedSize = read64(m_buffer, field);
+        }
+        pos += 4 + (size_t)len;
+    }
+    if (m_method != METHOD_STORE && m_method != METHOD_DEFLATE)
+    {
+        m_state = State::Error;
+        return false;
+    }
+    m_buffer.erase(0, headerLen);
+    m_scanAt = 0;
+    m_retryAt = 0;
+    m_state = State::Data;
+    return true;
+}
+
+/**
+ * Unpacks the data of the current entry if it is complete.
+ * Sets progress when the entry was consumed; returns false on corrupt data.
+ */
+bool ZipStreamReader::parseData(bool& progress)
+{
+    if (!(m_flags & FLAG_DATA_DESCRIPTOR))
+    {
+        // sizes are known from the local header
+        if (m_buffer.size() < m_compressedSize)
+            return true;
+        std::string data;
+        if (m_method == METHOD_STORE)
+            data = m_buffer.substr(0, (size_t)m_compressedSize);
+        else
+        {
+            size_t consumed = 0;
+            if (inflate(m_buffer.data(), (size_t)m_compressedSize, data, consumed) != 0)
+                return false;
+        }
+        m_buffer.erase(0, (size_t)m_compressedSize);
+        progress = true;
+        return emit(data, m_crc);
+    }
+
+    // sizes follow the data in a data descriptor
+    const size_t descriptorLen = m_zip64 ? 24 : 16;
+    size_t dataLen = 0;
+    std::string data;
+
+    // find the descriptor signature whose compressed size matches its own offset; only the bytes
+    // that arrived since the last call are scanned, so a large entry stays linear in its size
+    size_t pos = m_scanAt;
+    bool found = false;
+    while ((pos = m_buffer.find("PK\x07\x08", pos, 4)) != std::string::npos)
+    {
+        if (pos + descriptorLen > m_buffer.size())
+            break;
+        uint64_t size = m_zip64 ? read64(m_buffer, pos + 8) : read32(m_buffer, pos + 8);
+        if (size == pos)
+        {
+            if (m_method == METHOD_STORE)
+            {
+                data = m_buffer.substr(0, pos);
+                found = true;
+                break;
+            }
+            // a deflated entry must also end exactly at the signature
+            size_t consumed = 0;
+            data.clear();
+            if (inflate(m_buffer.data(), pos, data, consumed) == 0 && consumed == pos)
+            {
+                found = true;
+                break;
+            }
+        }
+        pos++;
+    }
+    if (found)
+        dataLen = pos;
+    else
+    {
+        m_scanAt = pos == std::string::npos ? (m_buffer.size() > 3 ? m_buffer.size() - 3 : 0) : pos;
+        if (m_method != METHOD_DEFLATE)
+            return true;
+        // descriptor without signature: deflate streams are self-terminating, so decode the whole
+        // buffer, but only after it doubled (to keep it linear) or once the stream ended
+        if (m_buffer.size() < m_retryAt && !m_ended)
+            return true;
+        data.clear();
+        int res = inflate(m_buffer.data(), m_buffer.size(), data, dataLen);
+        if (res < 0)
+            return false;
+        size_t needed = dataLen + descriptorLen - 4;
+        if (m_buffer.size() >= dataLen + 4 && read32(m_buffer, dataLen) == DATA_DESCRIPTOR_SIG)
+            needed += 4;
+        if (res == 1 || m_buffer.size() < needed)
+        {
+            m_retryAt = (std::max)(m_buffer.size() * 2, needed);
+            return true;
+        }
+    }
+
+    pos = dataLen;
+    if (read32(m_buffer, pos) == DATA_DESCRIPTOR_SIG)
+        pos += 4;
+    uint32_t crc = read32(m_buffer, pos);
+    pos += m_zip64 ? 20 : 12;
+    m_buffer.erase(0, pos);
+    progress = true;
+    return emit(data, crc);
+}
+
+bool ZipStreamReader::emit(const std::string& data, uint32_t crc)
+{
+    m_state = State::Header;
+    if (crc32(data.data(), data.size()) != crc)
+        return false;
+    if (!m_name.empty() && m_name.back() == '/')
+        return true;    // folder entry
+    return m_onEntry(m_name, data);
+}
@@ -36,100 +36,313 @@
 #include <sstream>
 #include <iomanip>
 #include <map>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <memory>
+#include <algorithm>
+#include <chrono>
 #include "CUrlTools.h"
+#include "Cancellation.h"
 
 #pragma comment(lib, "wininet.lib")
 
 /**
- * Performs an HTTP GET request using WinInet API
- *
- * @param url     The complete URL to send the GET request to (wide string)
- * @param headers Optional HTTP headers to include in the request (wide string)
- * @return        Response body as a string, or empty string on failure
+ * Keeps one WinInet session per pool and one connection handle per host.
  *
- * Note: This is a simplified implementation using InternetOpenUrl
- *       which doesn't provide fine-grained control over the request
+ * Creating a session per request (InternetOpen ... InternetCloseHandle) throws
+ * away the keep-alive sockets WinInet maintains inside the session, so every
+ * call paid a fresh TCP and TLS handshake. Handles kept here live for the whole
+ * process. API calls and storage downloads use different sessions.
  */
-std::string HttpGet(const std::wstring& url, const std::wstring& headers) {
-    HINTERNET hInternet = NULL;
-    HINTERNET hConnect = NULL;
-    HINTERNET hRequest = NULL;
-    std::string responseData;
-
-    // Initialize WinINet session with default configuration
-    hInternet = InternetOpen(
-        L"WinINetGetRequest",           // User agent string
-        INTERNET_OPEN_TYPE_PRECONFIG,   // Use registry/system proxy settings
-        NULL, NULL, 0);                 // No explicit proxy
-
-    if (!hInternet) {
-        std::cerr << "InternetOpen failed: " << GetLastError() << std::endl;
-        return "";
+class HttpConnectionPool
+{
+private:
+    struct Pool {
+        HINTERNET session = NULL;
+        std::map<std::wstring, HINTERNET> connections;   // "host:port" -> InternetConnect handle
+    };
+    static std::mutex m_mutex;
+    static Pool m_pools[2];
+    static const DWORD MAX_CONNS_PER_SERVER = 8;
+
+public:
+    /**
+     * Returns a connection handle for the host, creating the pool session on first use
+     *
+     * @param pool     Pool the request belongs to
+     * @param hostname Server host name
+     * @param port     Server port
+     * @return         Connection handle owned by the pool, or NULL on failure
+     */
+    static HINTERNET connect(HttpPool pool, const std::wstring& hostname, INTERNET_PORT port)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        Pool& p = m_pools[pool == HttpPool::Storage ? 1 : 0];
+        if (!p.session) {
+            p.session = InternetOpen(
+                pool == HttpPool::Storage ? L"FileJumpStorage/1.0" : L"FileJumpApi/1.0",
+                INTERNET_OPEN_TYPE_PRECONFIG,
+                NULL, NULL, 0);
+            if (!p.session) {
+                std::cerr << "InternetOpen failed: " << GetLastError() << std::endl;
+                return NULL;
+            }
+            // WinInet keeps this limit for the whole process and only accepts it with a NULL handle;
+            // its default of 2 per server would queue parallel transfers and hedged requests
+            DWORD maxConns = MAX_CONNS_PER_SERVER;
+            InternetSetOption(NULL, INTERNET_OPTION_MAX_CONNS_PER_SERVER, &maxConns, sizeof(maxConns));
+        }
+        std::wstring key = hostname + L":" + std::to_wstring(port);
+        auto it = p.connections.find(key);
+        if (it != p.connections.end())
+            return it->second;
+
+        HINTERNET hConnect = InternetConnect(
+            p.session,
+            hostname.c_str(),
+            port,
+            NULL, NULL,                 // No username/password
+            INTERNET_SERVICE_HTTP,
+            0, 0);
+        if (!hConnect) {
+            std::cerr << "InternetConnect failed: " << GetLastError() << std::endl;
+            return NULL;
+        }
+        p.connections[key] = hConnect;
+        return hConnect;
     }
+};
 
-    // Open the URL directly - combines connect and request creation
-    hConnect = InternetOpenUrl(
-        hInternet,
-        url.c_str(),                           // Target URL
-        headers.c_str(), (DWORD)headers.length(), // HTTP headers
-        INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE, // Don't use cache
-        0);                                    // Context value for callbacks
+std::mutex HttpConnectionPool::m_mutex;
+HttpConnectionPool::Pool HttpConnectionPool::m_pools[2];
 
-    if (!hConnect) {
-        std::cerr << "InternetOpenUrl failed: " << GetLastError() << std::endl;
-        InternetCloseHandle(hInternet);
-        return "";
+/**
+ * Builds the Range header for a partial GET
+ *
+ * @param offset First byte to fetch
+ * @param length Number of bytes to fetch, 0 means "up to the end of file"
+ * @return       Header line with CRLF, or empty string when the whole body is requested
+ */
+static std::wstring BuildRangeHeader(uint64_t offset, uint64_t length)
+{
+    if (offset == 0 && length == 0)
+        return L"";
+    std::wstring range = L"Range: bytes=" + std::to_wstring(offset) + L"-";
+    if (length)
+        range += std::to_wstring(offset + length - 1);
+    return range + L"\r\n";
+}
+
+/**
+ * Request handle shared with another thread that may abort the request.
+ * Closing a WinInet handle makes a blocking call on it fail at once.
+ */
+struct RequestSlot {
+    std::mutex m_mutex;
+    HINTERNET handle = NULL;
+    bool cancelled = false;
+    std::chrono::steady_clock::time_point responded;   // when the status line arrived, default = not yet
+
+    void cancel()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        cancelled = true;
+        if (handle)
+            InternetCloseHandle(handle);
+        handle = NULL;
+    }
+    // Returns false when the request was cancelled before it got its handle
+    bool attach(HINTERNET hRequest)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (cancelled)
+            return false;
+        handle = hRequest;
+        return true;
+    }
+    // Returns true when the request was cancelled; the handle is then already closed
+    bool detach()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        handle = NULL;
+        return cancelled;
+    }
+    void markResponded()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        responded = std::chrono::steady_clock::now();
+    }
+    std::chrono::steady_clock::time_point respondedAt()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return responded;
+    }
+    bool hasResponded()
+    {
+        return respondedAt() != std::chrono::steady_clock::time_point();
     }
+};
 
-    // Query the HTTP status code from the response
-    DWORD statusCode = 0;
-    DWORD statusCodeSize = sizeof(statusCode);
-    if (HttpQueryInfo(hConnect,
-        HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, // Get status as number
-        &statusCode,
-        &statusCodeSize,
-        NULL)) {
-        if (statusCode != 200) {
-            std::cerr << "HTTP Status: " << statusCode << std::endl;
-        }
+/**
+ * Circuit breaker per pool: after a run of failed requests (no response, timeout or 5xx) the
+ * circuit opens and requests fail at once instead of waiting for the connect and read timeouts.
+ * Once the open interval has passed, one request goes through as a probe: its success closes the
+ * circuit, its failure opens it again for twice as long, up to MAX_OPEN_MS.
+ */
+class CircuitBreaker
+{
+private:
+    static constexpr unsigned MAX_OPEN_MS = 60000;
+    struct Circuit {
+        HttpCircuitState state = HttpCircuitState::Closed;
+        unsigned failures = 0;          // consecutive
+        unsigned openMs = 0;            // current open interval
+        std::chrono::steady_clock::time_point retryAt;
+        bool probing = false;           // the probe of a half-open circuit is in flight
+        uint64_t trips = 0;
+        uint64_t rejected = 0;
+    };
+    std::mutex m_mutex;
+    Circuit circuits[2];
+
+    Circuit& circuit(HttpPool pool)
+    {
+        return circuits[pool == HttpPool::Storage ? 1 : 0];
+    }
+    void open(Circuit& c, unsigned ms)
+    {
+        c.state = HttpCircuitState::Open;
+        c.openMs = std::min(ms, MAX_OPEN_MS);
+        c.retryAt = std::chrono::steady_clock::now() + std::chrono::milliseconds(c.openMs);
+        c.probing = false;
+        c.trips++;
     }
 
-    // Read the response body in chunks
-    char buffer[4096];
-    DWORD bytesRead;
-    while (InternetReadFile(hConnect, buffer, sizeof(buffer), &bytesRead) && bytesRead > 0) {
-        responseData.append(buffer, bytesRead);
+public:
+    unsigned threshold = 5;             // consecutive failures that open the circuit, 0 = off
+    unsigned openMs = 5000;
+
+    // False when the request must fail at once; probe is set when the request tests a half-open circuit
+    bool allow(HttpPool pool, bool& probe)
+    {
+        probe = false;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        Circuit& c = circuit(pool);
+        if (c.state == HttpCircuitState::Closed)
+            return true;
+        if (c.state == HttpCircuitState::Open) {
+            if (std::chrono::steady_clock::now() < c.retryAt) {
+                c.rejected++;
+                return false;
+            }
+            c.state = HttpCircuitState::HalfOpen;
+        }
+        if (c.probing) {
+            c.rejected++;
+            return false;
+        }
+        c.probing = probe = true;
+        return true;
+    }
+    void record(HttpPool pool, bool ok, bool probe)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        Circuit& c = circuit(pool);
+        if (ok) {
+            c.failures = 0;
+            if (probe) {
+                c.state = HttpCircuitState::Closed;
+                c.probing = false;
+            }
+        }
+        else if (probe)
+            open(c, c.openMs * 2);
+        else if (c.state == HttpCircuitState::Closed && threshold && ++c.failures >= threshold)
+            open(c, openMs);
+    }
+    // The probe ended without an answer either way (cancelled): the next request probes
+    void abandon(HttpPool pool, bool probe)
+    {
+        if (!probe)
+            return;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        circuit(pool).probing = false;
+    }
+    // False only while the open interval lasts; a circuit that may be probed counts as available
+    bool available(HttpPool pool)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        Circuit& c = circuit(pool);
+        return c.state != HttpCircuitState::Open || std::chrono::steady_clock::now() >= c.retryAt;
+    }
+    void reset()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto& c : circuits) {
+            c.state = HttpCircuitState::Closed;
+            c.failures = 0;
+            c.probing = false;
+        }
+    }
+    HttpCircuitStats snapshot(HttpPool pool)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        Circuit& c = circuit(pool);
+        return { c.state, c.failures, c.trips, c.rejected };
     }
+};
+
+static CircuitBreaker g_breaker;
+
+void HttpSetCircuitBreaker(unsigned failures, unsigned openMs)
+{
+    g_breaker.openMs = std::max(openMs, 1u);
+    g_breaker.threshold = failures;
+    if (!failures)
+        g_breaker.reset();
+}
 
-    // Clean up handles
-    InternetCloseHandle(hConnect);
-    InternetCloseHandle(hInternet);
+HttpCircuitStats HttpGetCircuitStats(HttpPool pool)
+{
+    return g_breaker.snapshot(pool);
+}
 
-    return responseData;
+bool HttpAvailable(HttpPool pool)
+{
+    return g_breaker.available(pool);
 }
 
 /**
- * Generic HTTP request function that supports any HTTP method
+ * Sends one request through the connection pool and reads the whole response
  *
- * @param method  HTTP method (GET, POST, PUT, DELETE, etc.)
- * @param url     Complete URL for the request
- * @param headers HTTP headers to send (wide string format)
- * @param data    Request body data (for POST, PUT, etc.)
- * @return        Response body as string, or empty string on failure
+ * @param pool       Pool to take the connection from
+ * @param method     HTTP method (GET, POST, PUT, DELETE, etc.)
+ * @param url        Complete URL for the request
+ * @param headers    HTTP headers to send (wide string format)
+ * @param data       Request body data (for POST, PUT, etc.)
+ * @param extraFlags Additional HttpOpenRequest flags (e.g. INTERNET_FLAG_NO_AUTO_REDIRECT)
+ * @param sink       Optional consumer of a 2xx body; the body is then not kept in the response
+ * @param slot       Optional handle slot another thread can cancel the request through
+ * @return           Status, body and Location header; status is 0 when the request failed or was cancelled
  *
- * This function provides more control than HttpGet by allowing:
- * - Custom HTTP methods
- * - Request body data
- * - Full header control
- * - Proper URL parsing and connection handling
+ * The token installed on the calling thread (CancellationToken::Scope) bounds the request:
+ * its deadline becomes the connect, send and receive timeouts, and cancelling it closes the request.
  */
-std::string HttpRequest(const std::wstring& method, const std::wstring& url,
-    const std::wstring& headers, const std::string& data)
+static HttpResponse SendPooledRequest(HttpPool pool, const std::wstring& method, const std::wstring& url,
+    const std::wstring& headers, const std::string& data, DWORD extraFlags,
+    const HttpBodySink* sink = nullptr, RequestSlot* slot = nullptr)
 {
-    HINTERNET hInternet = NULL;
-    HINTERNET hConnect = NULL;
-    HINTERNET hRequest = NULL;
-    std::string responseData;
+    HttpResponse response;
+    CancellationToken* token = CancellationToken::current();
+    if (token && token->cancelled())
+        return response;
+    bool probe;
+    if (!g_breaker.allow(pool, probe))
+        return response;
+    RequestSlot tokenSlot;
+    if (token && !slot)
+        slot = &tokenSlot;
 
     // Parse the URL into its components (scheme, host, path, port)
     URL_COMPONENTS urlComp = {};
@@ -140,40 +353,21 @@ std::string HttpRequest(const std::wstring& method, const std::wstring& url,
 
     if (!InternetCrackUrl(url.c_str(), 0, 0, &urlComp)) {
         std::cerr << "InternetCrackUrl failed: " << GetLastError() << std::endl;
-        return "";
-    }
-
-    // Initialize WinINet with method-specific agent name
-    std::wstring agentName = L"WinINet" + method + L"Request";
-    hInternet = InternetOpen(
-        agentName.c_str(),
-        INTERNET_OPEN_TYPE_PRECONFIG,
-        NULL, NULL, 0);
-
-    if (!hInternet) {
-        std::cerr << "InternetOpen failed: " << GetLastError() << std::endl;
-        return "";
+        g_breaker.abandon(pool, probe);
+        return response;
     }
 
-    // Establish connection to the server
+    // Connection handle is owned by the pool and must not be closed here
     std::wstring hostname(urlComp.lpszHostName, urlComp.dwHostNameLength);
-    hConnect = InternetConnect(
-        hInternet,
-        hostname.c_str(),
-        urlComp.nPort,              // Use port from URL (80 for HTTP, 443 for HTTPS)
-        NULL, NULL,                 // No username/password
-        INTERNET_SERVICE_HTTP,
-        0, 0);
-
+    HINTERNET hConnect = HttpConnectionPool::connect(pool, hostname, urlComp.nPort);
     if (!hConnect) {
-        std::cerr << "InternetConnect failed: " << GetLastError() << std::endl;
-        InternetCloseHandle(hInternet);
-        return "";
+        g_breaker.record(pool, false, probe);
+        return response;
     }
 
     // Create the HTTP request
     std::wstring urlPath(urlComp.lpszUrlPath, urlComp.dwUrlPathLength);
-    hRequest = HttpOpenRequest(
+    HINTERNET hRequest = HttpOpenRequest(
         hConnect,
         method.c_str(),             // HTTP method (GET, POST, etc.)
         urlPath.c_str(),            // URL path (everything after hostname)
@@ -181,15 +375,47 @@ std::string HttpRequest(const std::wstring& method, const std::wstring& url,
         NULL,                       // Referrer
         NULL,                       // Accept types
         (urlComp.nScheme == INTERNET_SCHEME_HTTPS ? INTERNET_FLAG_SECURE : 0) |
-        INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE,
+        INTERNET_FLAG_KEEP_CONNECTION | INTERNET_FLAG_RELOAD | INTERNET_FLAG_NO_CACHE_WRITE | extraFlags,
         0);
 
     if (!hRequest) {
         std::cerr << "HttpOpenRequest failed: " << GetLastError() << std::endl;
-        InternetCloseHandle(hConnect);
-        InternetCloseHandle(hInternet);
-        return "";
+        g_breaker.abandon(pool, probe);
+        return response;
+    }
+    if (slot && !slot->attach(hRequest)) {
+        InternetCloseHandle(hRequest);
+        g_breaker.abandon(pool, probe);
+        return response;
     }
+    size_t subscription = SIZE_MAX;
+    if (token) {
+        DWORD timeout = token->remainingMs();
+        if (timeout != UINT_MAX) {
+            timeout = std::max<DWORD>(timeout, 1);
+            // the connection is opened by HttpSendRequest, so an unreachable server is bounded too
+            InternetSetOption(hRequest, INTERNET_OPTION_CONNECT_TIMEOUT, &timeout, sizeof(timeout));
+            InternetSetOption(hRequest, INTERNET_OPTION_SEND_TIMEOUT, &timeout, sizeof(timeout));
+            InternetSetOption(hRequest, INTERNET_OPTION_RECEIVE_TIMEOUT, &timeout, sizeof(timeout));
+        }
+        subscription = token->subscribe([slot] { slot->cancel(); });
+    }
+    bool abandoned = false;
+    // Closes the request unless a canceller already did; a cancelled request tells nothing about the server
+    auto closeRequest = [&]() {
+        if (token)
+            token->unsubscribe(subscription);
+        if (!slot || !slot->detach())
+            InternetCloseHandle(hRequest);
+        else
+            abandoned = true;
+        if (abandoned) {
+            response = HttpResponse();
+            g_breaker.abandon(pool, probe);
+        }
+        else
+            g_breaker.record(pool, response.status != 0 && response.status < 500, probe);
+    };
 
     // Send the HTTP request with headers and optional body data
     BOOL result = HttpSendRequest(
@@ -200,26 +426,357 @@ std::string HttpRequest(const std::wstring& method, const std::wstring& url,
         (DWORD)data.length());
 
     if (!result) {
-        std::cerr << "HttpSendRequest failed: " << GetLastError() << std::endl;
-        InternetCloseHandle(hRequest);
-        InternetCloseHandle(hConnect);
-        InternetCloseHandle(hInternet);
-        return "";
+        if (!slot || !slot->cancelled)
+            std::cerr << "HttpSendRequest failed: " << GetLastError() << std::endl;
+        closeRequest();
+        return response;
     }
 
-    // Read the response body
-    char buffer[4096];
+    // Query the HTTP status code from the response
+    DWORD statusCode = 0;
+    DWORD statusCodeSize = sizeof(statusCode);
+    HttpQueryInfo(hRequest, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER,
+        &statusCode, &statusCodeSize, NULL);
+    response.status = statusCode;
+    if (slot)
+        slot->markResponded();
+
+    // Redirects are only visible here when INTERNET_FLAG_NO_AUTO_REDIRECT is set
+    if (statusCode >= 300 && statusCode < 400) {
+        wchar_t location[4096] = { 0 };
+        DWORD locationSize = sizeof(location);
+        if (HttpQueryInfo(hRequest, HTTP_QUERY_LOCATION, location, &locationSize, NULL))
+            response.location = location;
+    }
+
+    // Read the response body; draining it lets WinInet return the socket to the pool
+    bool streamed = sink && statusCode >= 200 && statusCode < 300;
+    char buffer[16384];
     DWORD bytesRead;
     while (InternetReadFile(hRequest, buffer, sizeof(buffer), &bytesRead) && bytesRead > 0) {
-        responseData.append(buffer, bytesRead);
+        if (token && token->cancelled()) {
+            abandoned = true;
+            break;
+        }
+        if (!streamed)
+            response.body.append(buffer, bytesRead);
+        else if (!(*sink)(buffer, bytesRead))
+            break;      // consumer gave up - closing the handle drops the connection
     }
 
-    // Clean up all handles
-    InternetCloseHandle(hRequest);
-    InternetCloseHandle(hConnect);
-    InternetCloseHandle(hInternet);
+    // a cancelled request returns status 0, not the part of the body read before
+    closeRequest();
+    return response;
+}
 
-    return responseData;
+/**
+ * Hedging of idempotent GETs: when a request has not answered within a percentile of the
+ * recent times to first byte, the same request is sent again on another connection and the
+ * first response wins; the other request is cancelled. A request that has answered is not
+ * hedged while its body arrives. Each request earns a fraction of a hedge,
+ * so hedges never exceed that fraction of the requests.
+ */
+class HedgePolicy
+{
+private:
+    static constexpr size_t SAMPLES = 256;
+    static constexpr size_t MIN_SAMPLES = 20;
+    static constexpr unsigned MIN_DELAY_MS = 50;
+    std::mutex m_mutex;
+    std::vector<unsigned> latencies[2];     // ring buffer per pool, time to first byte in ms
+    size_t next[2] = { 0, 0 };
+    double tokens = 0;
+
+public:
+    bool enabled = false;
+    double percentile = 0.95;
+    double budget = 0.05;
+    HttpHedgeStats stats = {};
+
+    void record(HttpPool pool, unsigned ms)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto& l = latencies[pool == HttpPool::Storage ? 1 : 0];
+        size_t& n = next[pool == HttpPool::Storage ? 1 : 0];
+        if (l.size() < SAMPLES)
+            l.push_back(ms);
+        else
+            l[n++ % SAMPLES] = ms;
+    }
+    // Delay after which a request of the pool is hedged, 0 = not hedged (too few samples yet)
+    unsigned delay(HttpPool pool)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        stats.requests++;
+        tokens = std::min(tokens + budget, 10.0);
+        auto l = latencies[pool == HttpPool::Storage ? 1 : 0];
+        if (l.size() < MIN_SAMPLES)
+            return 0;
+        size_t k = std::min(l.size() - 1, (size_t)(percentile * l.size()));
+        std::nth_element(l.begin(), l.begin() + k, l.end());
+        stats.thresholdMs = std::max(l[k], MIN_DELAY_MS);
+        return stats.thresholdMs;
+    }
+    bool takeToken()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (tokens < 1)
+            return false;
+        tokens -= 1;
+        stats.hedged++;
+        return true;
+    }
+    void won()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        stats.hedgeWins++;
+    }
+    HttpHedgeStats snapshot()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return stats;
+    }
+};
+
+static HedgePolicy g_hedging;
+
+void HttpSetHedging(bool enabled, double percentile, double budget)
+{
+    g_hedging.percentile = percentile;
+    g_hedging.budget = budget;
+    g_hedging.enabled = enabled;
+}
+
+HttpHedgeStats HttpGetHedgeStats()
+{
+    return g_hedging.snapshot();
+}
+
+/**
+ * A GET that may be hedged: the first request runs on the caller's thread, the second one
+ * on its own thread. Whichever completes first cancels the other.
+ */
+struct HedgeRace {
+    HttpPool pool;
+    std::wstring url;           // copies: the hedge may outlive the caller when the first request wins
+    std::wstring headers;
+    DWORD extraFlags;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    RequestSlot first, second;
+    bool firstDone = false;
+    bool hedged = false;
+    bool secondDone = false;
+    HttpResponse secondResponse;
+
+    void sendSecond()
+    {
+        HttpResponse response = SendPooledRequest(pool, L"GET", url, headers, "", extraFlags, nullptr, &second);
+        std::unique_lock<std::mutex> lock(m_mutex);
+        secondResponse = std::move(response);
+        secondDone = true;
+        bool cancelFirst = secondResponse.status != 0 && !firstDone;
+        m_changed.notify_all();
+        lock.unlock();
+        if (cancelFirst)
+            first.cancel();
+    }
+};
+
+/**
+ * One thread for the hedging deadlines of all requests; a hedge gets its own thread only when sent
+ */
+class HedgeTimer
+{
+private:
+    std::mutex m_mutex;
+    std::condition_variable m_changed;
+    std::multimap<std::chrono::steady_clock::time_point, std::weak_ptr<HedgeRace>> deadlines;
+    bool running = false;
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true) {
+            if (deadlines.empty()) {
+                m_changed.wait(lock);
+                continue;
+            }
+            auto due = deadlines.begin()->first;
+            if (std::chrono::steady_clock::now() < due) {
+                m_changed.wait_until(lock, due);
+                continue;
+            }
+            std::shared_ptr<HedgeRace> race = deadlines.begin()->second.lock();
+            deadlines.erase(deadlines.begin());
+            if (!race)
+                continue;       // completed and gone
+            lock.unlock();
+            fire(race);
+            lock.lock();
+        }
+    }
+    static void fire(const std::shared_ptr<HedgeRace>& race);
+
+public:
+    void add(std::chrono::steady_clock::time_point due, const std::shared_ptr<HedgeRace>& race)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!running) {
+            running = true;
+            std::thread([this] { run(); }).detach();
+        }
+        deadlines.emplace(due, race);
+        m_changed.notify_one();
+    }
+};
+
+void HedgeTimer::fire(const std::shared_ptr<HedgeRace>& race)
+{
+    {
+        std::lock_guard<std::mutex> guard(race->m_mutex);
+        if (race->firstDone || race->first.hasResponded() || !g_hedging.takeToken())
+            return;
+        race->hedged = true;
+    }
+    std::thread([race] { race->sendSecond(); }).detach();
+}
+
+// Never destroyed: its detached thread may still wait on it while the process exits
+static HedgeTimer& hedgeTimer()
+{
+    static HedgeTimer* timer = new HedgeTimer;
+    return *timer;
+}
+
+/**
+ * Sends a GET, hedged when hedging is on and enough latencies were seen to set the delay
+ */
+static HttpResponse SendHedgedGet(HttpPool pool, const std::wstring& url, const std::wstring& headers, DWORD extraFlags)
+{
+    auto started = std::chrono::steady_clock::now();
+    // the delay is compared with the time to first byte, so that is what is sampled
+    auto record = [&](RequestSlot& slot) {
+        if (slot.hasResponded())
+            g_hedging.record(pool, (unsigned)std::chrono::duration_cast<std::chrono::milliseconds>(slot.respondedAt() - started).count());
+    };
+    unsigned delay = g_hedging.enabled ? g_hedging.delay(pool) : 0;
+    if (delay == 0) {
+        RequestSlot slot;
+        HttpResponse response = SendPooledRequest(pool, L"GET", url, headers, "", extraFlags, nullptr, &slot);
+        if (g_hedging.enabled && response.status != 0)
+            record(slot);
+        return response;
+    }
+
+    auto race = std::make_shared<HedgeRace>();
+    race->pool = pool;
+    race->url = url;
+    race->headers = headers;
+    race->extraFlags = extraFlags;
+    hedgeTimer().add(started + std::chrono::milliseconds(delay), race);
+
+    HttpResponse response = SendPooledRequest(pool, L"GET", url, headers, "", extraFlags, nullptr, &race->first);
+    std::unique_lock<std::mutex> lock(race->m_mutex);
+    race->firstDone = true;
+    if (response.status != 0) {
+        bool cancelSecond = race->hedged && !race->secondDone;
+        lock.unlock();
+        if (cancelSecond)
+            race->second.cancel();
+        record(race->first);
+        return response;
+    }
+    // the first request failed or lost: the hedge, if any, decides, unless the caller gave up
+    CancellationToken* token = CancellationToken::current();
+    if (!race->hedged || (token && token->cancelled())) {
+        bool cancelSecond = race->hedged && !race->secondDone;
+        lock.unlock();
+        if (cancelSecond)
+            race->second.cancel();
+        return response;
+    }
+    race->m_changed.wait(lock, [&] { return race->secondDone; });
+    if (race->secondResponse.status != 0)
+        g_hedging.won();
+    return race->secondResponse;
+}
+
+/**
+ * Performs an HTTP GET request using WinInet API
+ *
+ * @param url     The complete URL to send the GET request to (wide string)
+ * @param headers Optional HTTP headers to include in the request (wide string)
+ * @return        Response body as a string, or empty string on failure
+ *
+ * Note: Redirects are followed by WinInet; use HttpGetNoRedirect to see them
+ */
+std::string HttpGet(const std::wstring& url, const std::wstring& headers) {
+    HttpResponse response = SendHedgedGet(HttpPool::Api, url, headers, 0);
+    if (response.status != 0 && response.status != 200) {
+        std::cerr << "HTTP Status: " << response.status << std::endl;
+    }
+    return response.body;
+}
+
+/**
+ * Performs an HTTP GET request without following redirects, optionally for a byte range
+ *
+ * @param url     The complete URL to send the GET request to
+ * @param headers HTTP headers to include in the request
+ * @param offset  First byte to fetch
+ * @param length  Number of bytes to fetch, 0 = up to the end
+ * @param pool    Connection pool to use (API host or storage host)
+ * @return        Status code, body and redirect location
+ *
+ * The caller decides which headers go to the redirect target, so the API
+ * bearer token never leaks to the storage host. Only ranged reads are hedged:
+ * repeating a whole-file download would double its transfer.
+ */
+HttpResponse HttpGetNoRedirect(const std::wstring& url, const std::wstring& headers,
+    uint64_t offset, uint64_t length, HttpPool pool)
+{
+    if (length == 0)
+        return SendPooledRequest(pool, L"GET", url, headers + BuildRangeHeader(offset, length), "", INTERNET_FLAG_NO_AUTO_REDIRECT);
+    return SendHedgedGet(pool, url, headers + BuildRangeHeader(offset, length), INTERNET_FLAG_NO_AUTO_REDIRECT);
+}
+
+/**
+ * Performs an HTTP GET request and hands a successful body to the sink as it arrives
+ *
+ * @param url     The complete URL to send the GET request to
+ * @param headers HTTP headers to include in the request
+ * @param sink    Called for each received part of a 2xx body; returning false aborts the transfer
+ * @param pool    Connection pool to use (API host or storage host)
+ * @return        Status code and redirect location; body holds the error text of a non-2xx response
+ *
+ * Used for large responses (archives) that should not be buffered in memory.
+ */
+HttpResponse HttpGetStream(const std::wstring& url, const std::wstring& headers,
+    const HttpBodySink& sink, HttpPool pool)
+{
+    return SendPooledRequest(pool, L"GET", url, headers, "", INTERNET_FLAG_NO_AUTO_REDIRECT, &sink);
+}
+
+/**
+ * Generic HTTP request function that supports any HTTP method
+ *
+ * @param method  HTTP method (GET, POST, PUT, DELETE, etc.)
+ * @param url     Complete URL for the request
+ * @param headers HTTP headers to send (wide string format)
+ * @param data    Request body data (for POST, PUT, etc.)
+ * @return        Response body as string, or empty string on failure
+ *
+ * This function provides more control than HttpGet by allowing:
+ * - Custom HTTP methods
+ * - Request body data
+ * - Full header control
+ * - Proper URL parsing and connection handling
+ */
+std::string HttpRequest(const std::wstring& method, const std::wstring& url,
+    const std::wstring& headers, const std::string& data)
+{
+    return SendPooledRequest(HttpPool::Api, method, url, headers, data, 0).body;
 }
 
 /**
@@ -272,6 +829,9 @@ private:
     std::wstring baseUrl;              // Base URL for upload endpoint
     std::wstring token;                // Bearer authentication token
     bool cancel;                       // Flag to cancel ongoing upload
+    const CancellationToken* abort;    // Token owned by the caller, may be nullptr
+    bool started;                      // The request was sent, a failure is the network's or the server's
+    DWORD lastStatus;                  // Status of the last answer, 0 when the server did not answer
     static const size_t CHUNK_SIZE = 65536; // 64KB chunks for streaming
 
     /**
@@ -446,7 +1006,7 @@ private:
     bool WriteToRequest(HINTERNET hRequest, const char* data, DWORD size) {
         DWORD totalWritten = 0;
         while (totalWritten < size) {
-            if (cancel) {
+            if (cancelled()) {
                 return false;
             }
 
@@ -479,7 +1039,7 @@ private:
 
         // Read and write file in chunks
         while (file.read(buffer.data(), CHUNK_SIZE) || file.gcount() > 0) {
-            if (cancel) {
+            if (cancelled()) {
                 file.close();
                 return false;
             }
@@ -501,8 +1061,27 @@ public:
      * @param baseUrl Base URL for the upload endpoint
      * @param token   Bearer authentication token
      */
-    FileUploader(const std::wstring& baseUrl, const std::wstring& token)
-        : baseUrl(baseUrl), token(token), cancel(false) {
+    FileUploader(const std::wstring& baseUrl, const std::wstring& token, const CancellationToken* abort = nullptr)
+        : baseUrl(baseUrl), token(token), cancel(false), abort(abort ? abort : CancellationToken::current()),
+          started(false), lastStatus(0) {
+    }
+
+    bool cancelled() const {
+        return cancel || (abort && abort->cancelled());
+    }
+
+    /**
+     * Tells whether the last PostFile reached the network, unlike a file that could not be read
+     */
+    bool Started() const {
+        return started;
+    }
+
+    /**
+     * HTTP status of the last answer, 0 when the server did not answer
+     */
+    DWORD LastStatus() const {
+        return lastStatus;
     }
 
     /**
@@ -539,6 +1118,8 @@ public:
     {
         std::string responseUtf8;
         cancel = false;
+        started = false;
+        lastStatus = 0;
 
         // Generate unique boundary for this request
         std::string boundary = GenerateBoundary();
@@ -558,6 +1139,7 @@ public:
 
         // Retry loop with exponential backoff for timeout errors
         int timeout = 1000; // Start with 1 second timeout
+        started = true;
 
         while (true) {
             // Initialize WinInet session
@@ -673,7 +1255,7 @@ public:
                 InternetCloseHandle(hConnect);
                 InternetCloseHandle(hInternet);
 
-                if (cancel) {
+                if (cancelled()) {
                     return ""; // User cancelled
                 }
                 throw std::runtime_error("Failed to stream file data");
@@ -699,6 +1281,7 @@ public:
             DWORD statusCodeSize = sizeof(statusCode);
             HttpQueryInfo(hRequest, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER,
                 &statusCode, &statusCodeSize, NULL);
+            lastStatus = statusCode;
 
             // Read response body
             const DWORD bufferSize = 4096;
@@ -734,16 +1317,36 @@ public:
  * @param token    Bearer authentication token
  * @param fields   Map of form fields (name -> value)
  * @param fileName Path to file to upload
- * @return         Server response body
+ * @param cancel   Token that stops the upload, may be nullptr for the token installed on the thread
+ * @return         Server response body, empty when cancelled or while the API circuit is open
  * @throws         std::runtime_error on failure
  *
- * This is a simple wrapper around FileUploader class for single file uploads
+ * This is a simple wrapper around FileUploader class for single file uploads. The outcome counts
+ * for the API circuit breaker like a pooled request: no answer or a 5xx status is a failure,
+ * while a file that cannot be read and a cancelled upload tell nothing about the server.
  */
 std::string HttpPostMultipart(const std::wstring& url, const std::wstring& token,
     const std::map<std::string, std::string>& fields,
-    const std::string& fileName)
+    const std::string& fileName, const CancellationToken* cancel)
 {
-    FileUploader uploader(url, token);
-    std::string response = uploader.PostFile(fileName, fields);
+    bool probe;
+    if (!g_breaker.allow(HttpPool::Api, probe))
+        return "";
+    FileUploader uploader(url, token, cancel);
+    std::string response;
+    try {
+        response = uploader.PostFile(fileName, fields);
+    }
+    catch (...) {
+        if (uploader.Started() && !uploader.cancelled())
+            g_breaker.record(HttpPool::Api, uploader.LastStatus() != 0 && uploader.LastStatus() < 500, probe);
+        else
+            g_breaker.abandon(HttpPool::Api, probe);
+        throw;
+    }
+    if (response.empty())
+        g_breaker.abandon(HttpPool::Api, probe);
+    else
+        g_breaker.record(HttpPool::Api, true, probe);
     return response;
 }
\ No newline at end of file
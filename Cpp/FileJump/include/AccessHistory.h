@@ -0,0 +1,81 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "FileJump.h"
+
+/**
+ * @brief Aggregated record of the folders listed and files opened, used to warm the caches at the next mount
+ *
+ * Each path keeps an access count and a score that halves every halfLife without accesses, so a path
+ * read often long ago and one read once today both rank by how likely they are to be read again.
+ * Only paths are kept: ids and versions are looked up again when the history is used.
+ * When more than capacity paths are known, the coldest quarter is dropped.
+ */
+class FILEJUMP_API AccessHistory
+{
+public:
+    struct Entry
+    {
+        std::string path;
+        bool isDir;
+        uint32_t count;
+        double score;               // decayed to the time of the call
+        int64_t last;               // seconds since 1970
+    };
+
+    AccessHistory(size_t capacity = 65536, unsigned halfLifeHours = 72);
+
+    void touch(const std::string& path, bool isDir);
+    /**
+     * @brief The hottest paths of one kind, hottest first
+     */
+    std::vector<Entry> hottest(size_t count, bool dirs) const;
+    size_t size() const;
+
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);
+
+private:
+    struct Item
+    {
+        bool isDir;
+        uint32_t count;
+        double score;
+        int64_t last;
+    };
+    size_t m_capacity;
+    double m_halfLife;              // seconds
+    std::unordered_map<std::string, Item> items;
+    mutable std::mutex m_mutex;
+
+    double decayed(const Item& item, int64_t now) const;
+    void trim(int64_t now);
+};
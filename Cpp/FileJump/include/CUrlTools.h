@@ -92,6 +92,22 @@ public:
      * @endcode
      */
     static std::wstring urlEncode(const std::wstring& value);
+    /**
+     * @brief Get a decoded query parameter from a URL
+     *
+     * Looks up the first parameter with the given name (case-sensitive) in the
+     * query string of the URL and percent-decodes its value.
+     *
+     * @param url The full URL
+     * @param name Name of the parameter
+     * @return Parameter value, or empty string when the parameter is absent
+     *
+     * @code
+     * std::wstring v = CUrlTools::getQueryParam(L"https://host/f?X-Amz-Expires=300", L"X-Amz-Expires");
+     * // Result: "300"
+     * @endcode
+     */
+    static std::wstring getQueryParam(const std::wstring& url, const std::wstring& name);
 
     /**
      * @brief Convert narrow string (std::string) to wide string (std::wstring)
@@ -0,0 +1,108 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "FileJump.h"
+
+/**
+ * @brief Seekable block-compressed file format used for transparent upload compression
+ *
+ * The file is cut into blocks of BLOCK_SIZE bytes that are compressed independently
+ * (XPRESS Huffman from the Windows Compression API), so any byte range can be read
+ * by fetching and decompressing only the blocks that cover it.
+ *
+ * Layout:
+ * @code
+ * [block 0][block 1]...[block N-1]
+ * [seek table: N x { uint32 compressed size, uint32 original size }]
+ * [footer: uint32 N, uint32 block size, uint64 original file size, "FJZ1"]
+ * @endcode
+ * All integers are little-endian. A compressed size with STORED_FLAG set marks a
+ * block kept uncompressed because it did not shrink.
+ */
+class FILEJUMP_API CompressedFile
+{
+public:
+    static const uint32_t BLOCK_SIZE = 1024 * 1024;
+    static const uint32_t STORED_FLAG = 0x80000000;
+    static const size_t FOOTER_SIZE = 20;
+
+    struct SeekTable
+    {
+        uint32_t blockSize = 0;
+        uint64_t size = 0;                      // original file size
+        std::vector<uint64_t> offsets;          // offset of each block in the compressed file
+        std::vector<uint32_t> compressedSizes;  // raw table values, STORED_FLAG included
+        std::vector<uint32_t> sizes;            // original size of each block
+    };
+
+    /**
+     * @brief Compress a local file into the seekable format, using all cores
+     * @param source Path of the file to compress
+     * @param dest Path of the compressed file to create
+     * @param originalSize Receives the size of the source file
+     * @param compressedSize Receives the size of the created file
+     * @return true on success
+     */
+    static bool compress(const std::string& source, const std::string& dest, uint64_t& originalSize, uint64_t& compressedSize);
+
+    /**
+     * @brief Parse the seek table from the tail of a compressed file
+     * @param tail Last bytes of the file, at least FOOTER_SIZE
+     * @param table Receives the parsed table
+     * @param needed Receives the number of tail bytes required when tail is too short for the table
+     * @return true when the table was parsed; false with needed > tail.size() means "fetch more"
+     */
+    static bool parseSeekTable(const std::string& tail, SeekTable& table, size_t& needed);
+
+    /**
+     * @brief Decompress a run of consecutive blocks
+     * @param table Seek table of the file
+     * @param first Index of the first block
+     * @param data Compressed bytes of blocks first..first+k, starting at offsets[first]
+     * @param out Receives the original bytes of those blocks
+     * @return true on success
+     */
+    static bool decompressBlocks(const SeekTable& table, size_t first, const std::string& data, std::string& out);
+
+    /**
+     * @brief Decompress a whole compressed file held in memory
+     * @param file Content of the compressed file
+     * @param out Receives the original content
+     * @return true on success
+     */
+    static bool decompress(const std::string& file, std::string& out);
+
+    /**
+     * @brief Check whether a file type is worth compressing, judging by its extension
+     * @param name File name
+     * @return false for formats that are already compressed (archives, media, office documents)
+     */
+    static bool isCompressible(const std::string& name);
+};
@@ -0,0 +1,141 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "FileJump.h"
+
+/**
+ * @brief Local disk cache of downloaded file content with S3-FIFO eviction
+ *
+ * New content enters a small FIFO queue (10% of the capacity); only content read again while it
+ * is there moves to the main queue, everything else is evicted early and remembered in a ghost
+ * list. Content found in the ghost list goes straight to the main queue. The main queue evicts
+ * in FIFO order but gives recently read content another round. A bulk copy or a scan therefore
+ * passes through the small queue without flushing the working set.
+ * Files larger than 1/8 of the capacity are not admitted on their first read.
+ * A shadow LRU of the same size is kept to report what plain LRU would have hit.
+ * Kept content (pinned folders) stays out of the queues: it is never evicted and does not count
+ * towards the capacity.
+ */
+class FILEJUMP_API ContentCache
+{
+public:
+    struct Stats
+    {
+        uint64_t capacity;
+        uint64_t bytes;
+        uint64_t objects;
+        uint64_t lookups;
+        uint64_t hits;
+        uint64_t smallHits;
+        uint64_t mainHits;
+        uint64_t admitted;
+        uint64_t ghostAdmitted;     // admitted to the main queue because they were seen recently
+        uint64_t bypassed;          // large files not admitted on their first read
+        uint64_t promoted;          // moved from the small to the main queue
+        uint64_t evicted;
+        uint64_t lruHits;           // hits of the shadow LRU
+        uint64_t keptBytes;         // kept content, outside of the capacity
+        uint64_t keptObjects;
+    };
+
+    /**
+     * @param dir folder for the cached files, created when missing; files left by an earlier run are removed
+     * @param capacity size limit in bytes
+     */
+    ContentCache(const std::string& dir, uint64_t capacity);
+    ~ContentCache();
+
+    /**
+     * @brief Find the content of id at version
+     * @return path of the cached file, pinned until release(path); empty when not cached
+     */
+    std::string acquire(int id, uint64_t version);
+    /**
+     * @brief Whether the content of id at version is cached; unlike acquire, not counted as a read
+     */
+    bool contains(int id, uint64_t version) const;
+
+    /**
+     * @brief Offer a downloaded file to the cache
+     * @param cached set to true when the file was moved into the cache; the returned path is then pinned
+     * @param keep admit the file as kept content, whatever its size
+     * @return path to read the content from: the cached file, or file when it was not admitted
+     */
+    std::string admit(int id, uint64_t version, const std::string& file, uint64_t size, bool& cached, bool keep = false);
+    /**
+     * @brief Exempt the cached content of id from eviction, or return it to the main queue
+     * @return false when id is not cached
+     */
+    bool keep(int id, bool on);
+    bool kept(int id) const;
+
+    void release(const std::string& path);
+    void remove(int id);
+
+    Stats stats() const;
+    /**
+     * @brief Human-readable statistics, including the hit rates of S3-FIFO and of the shadow LRU
+     */
+    std::string report() const;
+
+private:
+    struct Object
+    {
+        uint64_t version;
+        uint64_t size;
+        std::string path;
+        uint8_t freq;
+        unsigned pins;
+        bool inMain;
+        bool kept;                      // not in a queue
+        std::list<int>::iterator pos;
+    };
+    std::string m_dir;
+    uint64_t m_capacity;
+    std::unordered_map<int, Object> objects;
+    std::unordered_map<std::string, int> paths;
+    std::list<int> small, main;                 // newest at the front
+    uint64_t smallBytes = 0, mainBytes = 0, keptBytes = 0;
+    std::list<int> ghost;
+    std::unordered_map<int, std::list<int>::iterator> ghostIndex;
+    std::unordered_map<std::string, unsigned> orphans;     // replaced files still open: path -> pins
+    std::list<std::pair<int, uint64_t>> lru;                // shadow LRU: id, size
+    std::unordered_map<int, std::list<std::pair<int, uint64_t>>::iterator> lruIndex;
+    uint64_t lruBytes = 0;
+    Stats m_stats = {};
+    mutable std::mutex m_mutex;
+
+    void drop(int id);
+    void setKept(int id, bool on);
+    void addGhost(int id);
+    void evict();
+    void touchLru(int id, uint64_t size);
+};
@@ -0,0 +1,105 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <windows.h>
+#include "FileJump.h"
+
+/**
+ * @brief Compact listing of a local tree: folders, files, sizes and times
+ *
+ * Names are packed into one string; folders and files refer to them by offset.
+ * Folder 0 is the root of the scan, every other folder and every file refers to its parent folder by index.
+ */
+struct FILEJUMP_API LocalSnapshot
+{
+    static const uint32_t NO_PARENT = 0xFFFFFFFF;
+
+    struct Dir
+    {
+        uint32_t parent;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+    };
+    struct File
+    {
+        uint32_t dir;
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        uint64_t size;
+        FILETIME created;
+        FILETIME modified;
+    };
+
+    std::vector<Dir> dirs;
+    std::vector<File> files;
+    std::string names;          // UTF-8
+    uint64_t errors = 0;        // folders that could not be listed
+
+    std::string name(const Dir& d) const
+    {
+        return names.substr(d.nameOffset, d.nameLength);
+    }
+    std::string name(const File& f) const
+    {
+        return names.substr(f.nameOffset, f.nameLength);
+    }
+    /**
+     * @brief Path of a folder relative to the root, '/'-separated, empty for the root
+     */
+    std::string dirPath(uint32_t dir) const;
+};
+
+/**
+ * @brief Parallel scanner of local folders
+ *
+ * Every worker lists folders with FindFirstFileEx (basic info, large fetch), keeps the
+ * subfolders it finds in its own queue and, when that runs dry, steals folders from the
+ * other workers, so a deep tree and a wide tree keep all workers busy.
+ * Folders that are reparse points (symbolic links, junctions) are not followed; files that are
+ * reparse points are listed.
+ */
+class FILEJUMP_API LocalScanner
+{
+public:
+    /**
+     * @param threads number of workers, 0 = number of CPUs
+     */
+    explicit LocalScanner(unsigned threads = 0);
+
+    /**
+     * @brief Scan a local folder
+     * @param root Folder to scan, UTF-8
+     * @param snapshot Receives the listing
+     * @return false when the root cannot be listed
+     */
+    bool scan(const std::string& root, LocalSnapshot& snapshot);
+
+private:
+    unsigned m_threads;
+};
@@ -0,0 +1,126 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <shared_mutex>
+#include <functional>
+#include <cstdint>
+#include "FileJump.h"
+
+struct FileInfo;
+
+/**
+ * @brief In-memory index of all remote entries for local queries
+ *
+ * Names are kept in one arena separated by '\0', plus an ASCII-lowercased copy with the same
+ * offsets that substring and glob queries scan with SSE2 (first/last byte match, then compare),
+ * so a query over a million names does not touch the entries that cannot match.
+ * Entries refer to their parent by id; paths are rebuilt only for results.
+ * The index can be saved to and loaded from a snapshot file.
+ */
+class FILEJUMP_API NameIndex
+{
+public:
+    struct Query
+    {
+        std::string text;           // substring of the name, case-insensitive
+        std::string glob;           // '*' and '?' pattern for the whole name, case-insensitive
+        std::string regex;          // ECMAScript regular expression searched in the name, case-insensitive
+        std::string prefix;         // only entries under this folder path, like "/docs/2024"
+        uint64_t minSize = 0;
+        uint64_t maxSize = UINT64_MAX;
+        uint64_t after = 0;         // modified at or after, FILETIME ticks
+        uint64_t before = UINT64_MAX;   // modified before, FILETIME ticks
+        int type = 0;               // 0 = all, 1 = files only, 2 = folders only
+        size_t limit = 1000;
+
+        /**
+         * @brief Parse a query like "name=*.pdf&minsize=1M&after=2024-01-01&prefix=%2Fdocs"
+         * @details Keys: text, name (glob), regex, prefix, minsize, maxsize (K/M/G suffixes), after, before
+         *          (YYYY-MM-DD, UTC), type (file/dir), limit. Values are percent-decoded. Text without '='
+         *          is a substring query.
+         * @return false on an unknown key or a bad value
+         */
+        static bool parse(const std::string& text, Query& query);
+    };
+
+    struct Match
+    {
+        std::string path;           // full path, like "/docs/report.pdf"
+        std::string name;
+        int id;
+        int parent_id;
+        uint64_t size;
+        uint64_t created;           // FILETIME ticks
+        uint64_t modified;
+        bool isDir;
+    };
+
+    void clear();
+    void add(const FileInfo& fi);
+    // Drop an entry; a folder takes everything under it along
+    void remove(int id);
+    size_t size() const;
+
+    std::vector<Match> search(const Query& query) const;
+
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);
+
+    /**
+     * @brief Call found for every position of needle in haystack (SSE2)
+     */
+    static void findAll(const std::string& haystack, const std::string& needle, const std::function<bool(size_t)>& found);
+    static bool globMatch(const char* name, size_t nameLength, const char* pattern, size_t patternLength);
+
+private:
+    struct Record
+    {
+        uint32_t nameOffset;
+        uint32_t nameLength;
+        int id;                     // -1 for a removed record
+        int parent;
+        uint64_t size;
+        uint64_t created;
+        uint64_t modified;
+        bool isDir;
+    };
+
+    std::vector<Record> records;    // ordered by nameOffset
+    std::string names;
+    std::string folded;
+    std::unordered_map<int, uint32_t> byId;
+    size_t removed = 0;
+    mutable std::shared_mutex m_mutex;
+
+    void append(const Record& r, const std::string& name);
+    void compact();
+    std::string path(const Record& r) const;
+    bool under(const Record& r, int folderId) const;
+    int findFolder(const std::string& path) const;
+};
@@ -0,0 +1,219 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <atomic>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "FileJump.h"
+
+/**
+ * @brief Epoch-based reclamation for data published through atomic pointers
+ *
+ * A reader holds an Epoch::Guard while it uses a snapshot; the guard only writes the current
+ * epoch into a per-thread slot, it takes no lock. A writer publishes a new snapshot, then
+ * retires the old one; retired snapshots are freed once no guard that started before the
+ * retirement is still alive.
+ */
+class FILEJUMP_API Epoch
+{
+public:
+    class FILEJUMP_API Guard
+    {
+    public:
+        Guard();
+        ~Guard();
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    /**
+     * @brief Call free once no reader can still see the retired data
+     */
+    static void retire(std::function<void()> free);
+};
+
+/**
+ * @brief Read-mostly hash map: lock-free lookups, copy-on-write updates
+ *
+ * The map is split into shards, every shard is an immutable std::unordered_map published
+ * through an atomic pointer. An update copies one shard, changes the copy and publishes it,
+ * so writers pay for the size of a shard and readers never wait.
+ */
+template <class K, class V, class H = std::hash<K>>
+class RcuMap
+{
+private:
+    static const size_t SHARDS = 16;
+    using Map = std::unordered_map<K, V, H>;
+    std::atomic<const Map*> shards[SHARDS];
+    std::atomic<size_t> count{ 0 };
+    std::mutex m_write;
+
+    size_t shardOf(const K& key) const
+    {
+        return (H()(key) * 0x9E3779B97F4A7C15ull >> 32) % SHARDS;
+    }
+    // m_write must be held
+    void publish(size_t shard, Map* map)
+    {
+        const Map* old = shards[shard].exchange(map);
+        count += map->size();
+        count -= old->size();
+        Epoch::retire([old] { delete old; });
+    }
+
+public:
+    RcuMap()
+    {
+        for (auto& s : shards)
+            s = new Map();
+    }
+    ~RcuMap()
+    {
+        for (auto& s : shards)
+            delete s.load();
+    }
+    RcuMap(const RcuMap&) = delete;
+    RcuMap& operator=(const RcuMap&) = delete;
+
+    bool find(const K& key, V& value) const
+    {
+        Epoch::Guard guard;
+        const Map* map = shards[shardOf(key)].load();
+        auto it = map->find(key);
+        if (it == map->end())
+            return false;
+        value = it->second;
+        return true;
+    }
+    bool contains(const K& key) const
+    {
+        Epoch::Guard guard;
+        const Map* map = shards[shardOf(key)].load();
+        return map->count(key) != 0;
+    }
+    size_t size() const
+    {
+        return count;
+    }
+    bool empty() const
+    {
+        return count == 0;
+    }
+    // fn(key, value) for every entry of a consistent snapshot of each shard
+    template <class F>
+    void forEach(F fn) const
+    {
+        Epoch::Guard guard;
+        for (auto& s : shards)
+            for (auto& kv : *s.load())
+                fn(kv.first, kv.second);
+    }
+
+    void set(const K& key, const V& value)
+    {
+        std::lock_guard<std::mutex> guard(m_write);
+        size_t shard = shardOf(key);
+        Map* map = new Map(*shards[shard].load());
+        (*map)[key] = value;
+        publish(shard, map);
+    }
+    // Many entries with one copy per shard
+    void set(const std::vector<std::pair<K, V>>& items)
+    {
+        std::lock_guard<std::mutex> guard(m_write);
+        Map* maps[SHARDS] = {};
+        for (auto& item : items)
+        {
+            size_t shard = shardOf(item.first);
+            if (!maps[shard])
+                maps[shard] = new Map(*shards[shard].load());
+            (*maps[shard])[item.first] = item.second;
+        }
+        for (size_t i = 0; i < SHARDS; i++)
+            if (maps[i])
+                publish(i, maps[i]);
+    }
+    bool erase(const K& key)
+    {
+        std::lock_guard<std::mutex> guard(m_write);
+        size_t shard = shardOf(key);
+        if (!shards[shard].load()->count(key))
+            return false;
+        Map* map = new Map(*shards[shard].load());
+        map->erase(key);
+        publish(shard, map);
+        return true;
+    }
+    // Remove the entries for which pred(key, value) is true
+    template <class F>
+    void eraseIf(F pred)
+    {
+        std::lock_guard<std::mutex> guard(m_write);
+        for (size_t i = 0; i < SHARDS; i++)
+        {
+            const Map* current = shards[i].load();
+            Map* map = nullptr;
+            for (auto& kv : *current)
+            {
+                if (pred(kv.first, kv.second))
+                {
+                    if (!map)
+                        map = new Map(*current);
+                    map->erase(kv.first);
+                }
+            }
+            if (map)
+                publish(i, map);
+        }
+    }
+    // Apply fn(value) to a copy of an existing entry and publish it when fn returns true
+    template <class F>
+    bool modify(const K& key, F fn)
+    {
+        std::lock_guard<std::mutex> guard(m_write);
+        size_t shard = shardOf(key);
+        auto it = shards[shard].load()->find(key);
+        if (it == shards[shard].load()->end())
+            return false;
+        V value = it->second;
+        if (!fn(value))
+            return false;
+        Map* map = new Map(*shards[shard].load());
+        (*map)[key] = value;
+        publish(shard, map);
+        return true;
+    }
+    void clear()
+    {
+        std::lock_guard<std::mutex> guard(m_write);
+        for (size_t i = 0; i < SHARDS; i++)
+            if (!shards[i].load()->empty())
+                publish(i, new Map());
+    }
+};
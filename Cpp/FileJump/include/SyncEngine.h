@@ -0,0 +1,138 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <string>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <filesystem>
+#include <cstdint>
+#include <vector>
+#include "FileJump.h"
+#include "LocalScanner.h"
+
+class FJAccess;
+struct FileInfo;
+class TaskPool;
+
+struct SyncOptions
+{
+    unsigned threads = 4;       // parallel uploads and deletes
+    bool deleteExtra = false;   // delete remote entries that do not exist locally
+    bool compareHash = false;   // compare SHA-256 when size matches but the time does not
+    bool dryRun = false;        // report what would be done, change nothing
+};
+
+struct SyncStats
+{
+    uint64_t scanned = 0;
+    uint64_t uploaded = 0;
+    uint64_t skipped = 0;
+    uint64_t folders = 0;
+    uint64_t deleted = 0;
+    uint64_t failed = 0;
+    uint64_t bytes = 0;
+};
+
+/**
+ * @brief One-way synchronization of a local folder to a FileJump folder
+ *
+ * The local tree is listed once with LocalScanner; every local folder is compared with one listing of its
+ * remote counterpart, so the work is linear in the number of entries. A file is unchanged
+ * when its size matches and either the modification time recorded in the description
+ * (the same "SHA256"/"ctime"/"utime" description the Python FjOperations writes) matches,
+ * or, for files without that description, the remote entry is newer than the local file.
+ * With compareHash, a time mismatch is resolved by comparing SHA-256 before uploading.
+ *
+ * Folders are created while walking; uploads, replacements and deletes run on a TaskPool.
+ * Files are uploaded as they are, without transparent compression or chunking.
+ *
+ * @code
+ * SyncEngine engine(FJAccess::getInstance());
+ * SyncStats stats;
+ * engine.sync("C:\\Photos", "/backup/photos", SyncOptions(), stats);
+ * @endcode
+ */
+class FILEJUMP_API SyncEngine
+{
+public:
+    enum class Action { CreateFolder, Upload, Replace, Delete, Skip, Fail };
+    typedef std::function<void(Action, const std::string&)> Progress;
+
+    explicit SyncEngine(FJAccess* access);
+
+    /**
+     * @brief Synchronize a local folder into a remote folder
+     * @param localDir Local folder
+     * @param remotePath Remote folder, like "/backup/photos"; missing folders are created
+     * @param options Options
+     * @param stats Receives the counters
+     * @param progress Called for every action, from the worker threads; may be empty
+     * @return true when nothing failed
+     */
+    bool sync(const std::string& localDir, const std::string& remotePath, const SyncOptions& options,
+        SyncStats& stats, const Progress& progress = nullptr);
+
+    /**
+     * @brief Find the id of a remote folder by walking its path from the root
+     * @param remotePath Remote folder, like "/backup/photos"
+     * @param create Create missing folders
+     * @return id of the folder, -1 when it does not exist or cannot be created
+     */
+    int resolveFolder(const std::string& remotePath, bool create);
+
+    /**
+     * @brief Calculate SHA-256 of a file
+     * @return Lowercase hex digest, empty string on failure
+     */
+    static std::string fileSha256(const std::filesystem::path& path);
+
+private:
+    struct Counters
+    {
+        std::atomic<uint64_t> scanned{ 0 }, uploaded{ 0 }, skipped{ 0 }, folders{ 0 }, deleted{ 0 }, failed{ 0 }, bytes{ 0 };
+    };
+    struct Context
+    {
+        SyncOptions options;
+        std::filesystem::path root;
+        LocalSnapshot snapshot;
+        std::vector<std::vector<uint32_t>> subdirs;     // folder index -> subfolder indexes
+        std::vector<std::vector<uint32_t>> files;       // folder index -> file indexes
+        Progress progress;
+        TaskPool* pool;
+        Counters counters;
+        std::mutex progressMutex;
+    };
+
+    FJAccess* m_access;
+
+    void syncFolder(uint32_t dir, const std::string& rel, int remoteId, Context& ctx);
+    void uploadTask(const std::filesystem::path& local, const std::string& rel, int remoteId, const FileInfo& old, bool verify, Context& ctx);
+    void report(Context& ctx, Action action, const std::string& path);
+    static std::string describe(const std::filesystem::path& local, const std::string& sha256);
+    static std::string folderName(const std::string& name);
+};
@@ -0,0 +1,102 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+
+    @class   TaskPool
+    @brief   Class runs submitted tasks on a fixed set of worker threads;
+    @details wait() returns when the queue is empty and no task is running. Tasks must not throw.
+
+**/
+class TaskPool
+{
+private:
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_ready;
+	std::condition_variable m_idle;
+	size_t busy = 0;
+	bool stopping = false;
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (true)
+		{
+			m_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+			if (tasks.empty())
+				return;
+			std::function<void()> task = std::move(tasks.front());
+			tasks.pop_front();
+			busy++;
+			lock.unlock();
+			task();
+			lock.lock();
+			busy--;
+			if (tasks.empty() && busy == 0)
+				m_idle.notify_all();
+		}
+	}
+public:
+	explicit TaskPool(unsigned threads)
+	{
+		if (threads == 0)
+			threads = 1;
+		for (unsigned i = 0; i < threads; i++)
+			workers.emplace_back([this] { run(); });
+	}
+	~TaskPool()
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			stopping = true;
+		}
+		m_ready.notify_all();
+		for (auto& w : workers)
+			w.join();
+	}
+	void submit(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			tasks.push_back(std::move(task));
+		}
+		m_ready.notify_one();
+	}
+	void wait()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this] { return tasks.empty() && busy == 0; });
+	}
+};
@@ -0,0 +1,84 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <list>
+#include <atomic>
+#include <functional>
+#include "FileJump.h"
+
+struct FileInfo;
+class FJAccess;
+
+/**
+ * @brief Parallel crawler of the remote folder tree
+ *
+ * Every worker keeps the subfolders it finds in its own queue and, when that runs dry, steals
+ * folders from the other workers, so many listings are in flight whatever the shape of the tree.
+ * The number of listings in flight adapts to the server: it is halved when a listing fails (the
+ * folder is retried later) and grows by one after as many successes as the current limit, up to
+ * the number of workers.
+ */
+class FILEJUMP_API TreeCrawler
+{
+public:
+    struct Progress
+    {
+        uint64_t folders;       // folders listed
+        uint64_t entries;       // entries found
+        uint64_t pending;       // folders queued or being listed
+        uint64_t failed;        // folders given up after retries
+        unsigned inFlight;      // current limit of parallel listings
+    };
+    // Called for every listed folder, one call at a time
+    using OnFolder = std::function<void(int id, const std::list<FileInfo>& entries)>;
+    // Called about twice a second and once at the end
+    using OnProgress = std::function<void(const Progress& progress)>;
+
+    /**
+     * @param threads maximum number of listings in flight
+     */
+    TreeCrawler(FJAccess* access, unsigned threads = 8);
+
+    /**
+     * @brief List the folder root and everything under it
+     * @return false when cancelled or when some folders could not be listed
+     */
+    bool crawl(int root, const OnFolder& onFolder, const OnProgress& onProgress = nullptr);
+
+    /**
+     * @brief Stop a running crawl; may be called from any thread
+     * @details Also stops a crawl that has not started yet: a cancelled crawler stays cancelled.
+     */
+    void cancel()
+    {
+        cancelled = true;
+    }
+
+private:
+    FJAccess* m_access;
+    unsigned m_threads;
+    std::atomic<bool> cancelled{ false };
+};
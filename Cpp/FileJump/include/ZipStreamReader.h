@@ -0,0 +1,134 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+
+#include <string>
+#include <functional>
+#include <cstdint>
+#include "FileJump.h"
+
+/**
+ * @brief Incremental reader of a ZIP archive that arrives as a byte stream
+ *
+ * ZipStreamReader unpacks local file entries as soon as their data is complete,
+ * without waiting for the central directory at the end of the archive. It is
+ * meant for archives produced on the fly by the server (multi-entry downloads),
+ * which use data descriptors because sizes are unknown when each entry starts.
+ *
+ * Supported: stored and deflated entries, data descriptors with or without
+ * signature, ZIP64 sizes. CRC32 of every entry is verified.
+ *
+ * Example usage:
+ * @code
+ * ZipStreamReader reader([](const std::string& name, const std::string& data) {
+ *     std::ofstream(name, std::ios::binary).write(data.data(), data.size());
+ *     return true;
+ * });
+ * bool ok = true;
+ * while (ok && receive(chunk))
+ *     ok = reader.feed(chunk.data(), chunk.size());
+ * ok = ok && reader.finish() && reader.finished();
+ * @endcode
+ */
+class FILEJUMP_API ZipStreamReader
+{
+public:
+    /**
+     * @brief Called once per unpacked file entry
+     * @param name Entry name as stored in the archive (folders separated by '/')
+     * @param data Uncompressed content
+     * @return false to stop reading the archive
+     */
+    typedef std::function<bool(const std::string& name, const std::string& data)> EntryCallback;
+
+    explicit ZipStreamReader(EntryCallback onEntry);
+
+    /**
+     * @brief Append the next part of the archive and unpack all entries completed by it
+     * @param data Next bytes of the stream
+     * @param size Number of bytes
+     * @return false when the archive is corrupt or the callback asked to stop
+     */
+    bool feed(const char* data, size_t size);
+
+    /**
+     * @brief Check whether the end of the file entries (central directory) was reached
+     * @return true when all entries of the archive were unpacked
+     */
+    bool finished() const { return m_finished; }
+
+    /**
+     * @brief Tell the reader that the stream ended and unpack an entry that is still pending
+     * @details Needed only for a deflated entry whose data descriptor has no signature, and for
+     *          archives cut off right after the descriptor of their last entry.
+     * @return false when the archive is corrupt or the callback asked to stop
+     */
+    bool finish();
+
+    /**
+     * @brief Calculate CRC32 (the ZIP/zlib polynomial) of a buffer
+     * @param data Buffer
+     * @param size Number of bytes
+     * @param crc Running value of a previous call, 0 to start
+     * @return CRC32 value
+     */
+    static uint32_t crc32(const char* data, size_t size, uint32_t crc = 0);
+
+    /**
+     * @brief Decompress a raw deflate (RFC 1951) stream
+     * @param data Compressed data, may continue past the end of the stream
+     * @param size Number of bytes available
+     * @param out Receives the uncompressed data
+     * @param consumed Receives the number of compressed bytes the stream occupied
+     * @return 0 on success, 1 when the stream continues past the available data, negative on corrupt data
+     */
+    static int inflate(const char* data, size_t size, std::string& out, size_t& consumed);
+
+private:
+    enum class State { Header, Data, Done, Error };
+
+    EntryCallback m_onEntry;
+    std::string m_buffer;       // unparsed tail of the stream
+    State m_state;
+    bool m_finished;
+
+    // current entry, valid in State::Data
+    std::string m_name;
+    uint16_t m_flags;
+    uint16_t m_method;
+    uint32_t m_crc;
+    uint64_t m_compressedSize;
+    uint64_t m_size;
+    bool m_zip64;
+    bool m_ended;               // finish() was called
+    size_t m_scanAt;            // where the search for the data descriptor signature continues
+    size_t m_retryAt;           // buffer size at which a deflated entry without signature is decoded again
+
+    bool parse();
+    bool parseHeader();
+    bool parseData(bool& progress);
+    bool emit(const std::string& data, uint32_t crc);
+};
@@ -32,28 +32,99 @@
 #include <cstring>
 #include <iostream>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
 #include <fstream>
 #include <algorithm>
 #include <filesystem>
+#include <thread>
+#include <chrono>
+#include <functional>
+#include <condition_variable>
+#include <map>
+#include <set>
+#include <memory>
 #include <windows.h>
 #include <fcntl.h>   // defines O_TRUNC, O_CREAT on many toolchains
 #include <io.h>      // sometimes needed on Windows
 
 #include "FJAccess.h"
+#include "ChangeWatcher.h"
+#include "TreeCrawler.h"
+#include "ContentCache.h"
+#include "HeadCache.h"
+#include "AccessHistory.h"
+#include "TaskPool.h"
 #include "CUrlTools.h"
 namespace fs = std::filesystem;
 
 struct HandleInfo {
     std::string localPath;
     bool dirty = false;
+    bool cached = false;    // localPath is a pinned file of g_cache
+    bool writable = false;
+    bool localOnly = false; // localPath belongs to g_local and is never uploaded
+    // content not fetched yet: remote entry, its version and size; 0 once localPath holds the content
+    int id = 0;
+    uint64_t version = 0;
+    uint64_t size = 0;
+    // last range read from FileJump for a large file that is not fetched
+    uint64_t bufferOffset = 0;
+    std::string buffer;
+    std::shared_ptr<std::mutex> fetch = std::make_shared<std::mutex>();
+    // cancelled at release, so a download for a closed handle stops at once
+    std::shared_ptr<CancellationToken> cancel = std::make_shared<CancellationToken>();
 };
 
+// Files up to this size are fetched whole on the first read, larger ones are read by ranges
+static const uint64_t SMALL_FILE = 4 * 1024 * 1024;
+// Minimum length of a range read, so sequential reads do not become one request each
+static const uint64_t READ_WINDOW = 1024 * 1024;
+
 static bool verbose = false;
 static std::unordered_map<uint64_t, HandleInfo> g_handles;
 static std::mutex g_handles_mutex;
 static uint64_t g_next_handle = 1;
 static std::string g_tempDir;
+static unsigned g_watchInterval = 0;
+static ChangeWatcher* g_watcher = nullptr;
+static struct fuse* g_fuse = nullptr;
+static bool g_warmup = false;
+static TreeCrawler* g_crawler = nullptr;
+static std::thread g_warmupThread;
+static std::mutex g_warmupMutex;                // guards starting and stopping the warm-up
+static std::atomic<bool> g_warmupRunning(false);
+static uint64_t g_warmupStarted = 0;            // GetTickCount64 of the last start
+static bool g_warmupClosed = false;             // unmounting: no new warm-up
+static ContentCache* g_cache = nullptr;
+static unsigned g_opTimeoutMs = 0;
+static HeadCache* g_heads = nullptr;
+static TaskPool* g_headPool = nullptr;
+static std::unordered_set<int> g_headsPending;
+static std::mutex g_heads_mutex;
+static std::atomic<bool> g_stopping(false);
+static AccessHistory* g_history = nullptr;
+static uint64_t g_warmBudget = 0;
+static std::thread g_historyThread;
+static CancellationToken g_historyCancel;
+
+// Deadline of one FUSE operation (--timeout): the requests it sends give up when it passes
+struct OpDeadline
+{
+    CancellationToken token;
+    CancellationToken::Scope scope;
+    OpDeadline() : token(g_opTimeoutMs), scope(g_opTimeoutMs ? &token : nullptr) {}
+};
+
+// Read-only virtual tree: /.filejumpfs/search/<query> lists the entries matching the query,
+// /.filejumpfs/stats shows the content cache statistics
+static const std::string VIRTUAL_ROOT = "/.filejumpfs";
+static const std::string SEARCH_DIR = VIRTUAL_ROOT + "/search";
+static const std::string STATS_FILE = VIRTUAL_ROOT + "/stats";
+
+enum class VirtualKind { None, Folder, Result, Stats, Missing };
 
 // normalize a fuse path like "/a/b.txt" -> "a/b.txt" (no leading slash for remote API)
 static std::string norm(const char* path) {
@@ -90,8 +161,827 @@ struct fuse_timespec filetime_to_timespec(FILETIME ft)
     return ts;
 }
 
+static void startWarmup();
+
+typedef std::vector<std::pair<std::string, NameIndex::Match>> SearchList;
+
+/**
+    @class SearchCache
+    @brief Class keeps the results of recent searches, so the getattr, open and readdir calls under
+           a search folder do not search again;
+    @details Results of a complete index live SEARCH_TTL_MS, results of an index still being built
+             PARTIAL_TTL_MS, so a listing fills up as the crawl goes on.
+**/
+class SearchCache
+{
+private:
+    static constexpr uint64_t SEARCH_TTL_MS = 10000;
+    static constexpr uint64_t PARTIAL_TTL_MS = 1000;
+    static constexpr size_t CAPACITY = 64;
+    struct Entry
+    {
+        uint64_t expires;
+        std::shared_ptr<const SearchList> results;
+    };
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> entries;
+
+public:
+    std::shared_ptr<const SearchList> get(const std::string& query)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = entries.find(query);
+        if (it == entries.end())
+            return nullptr;
+        if (it->second.expires <= GetTickCount64())
+        {
+            entries.erase(it);
+            return nullptr;
+        }
+        return it->second.results;
+    }
+    void put(const std::string& query, const std::shared_ptr<const SearchList>& results, bool complete)
+    {
+        uint64_t now = GetTickCount64();
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (entries.size() >= CAPACITY)
+            for (auto it = entries.begin(); it != entries.end(); )
+                it = it->second.expires <= now ? entries.erase(it) : std::next(it);
+        if (entries.size() >= CAPACITY)
+            entries.erase(entries.begin());
+        entries[query] = { now + (complete ? SEARCH_TTL_MS : PARTIAL_TTL_MS), results };
+    }
+};
+
+static SearchCache g_searches;
+
+// Search results listed by name; names that occur more than once get the entry id before the extension.
+// Until the index covers the whole tree it is built in the background and the results found so far are listed
+static std::shared_ptr<const SearchList> searchResults(const std::string& query)
+{
+    auto cached = g_searches.get(query);
+    if (cached)
+        return cached;
+    auto out = std::make_shared<SearchList>();
+    NameIndex::Query q;
+    if (!NameIndex::Query::parse(query, q))
+        return out;
+    FJAccess* access = FJAccess::getInstance();
+    bool complete = access->indexReady();
+    if (!complete)
+        startWarmup();
+    auto matches = access->search(q, false);
+    auto key = [](std::string name)
+    {
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        return name;
+    };
+    std::unordered_map<std::string, int> seen;
+    for (auto& m : matches)
+        seen[key(m.name)]++;
+    for (auto& m : matches)
+    {
+        std::string name = m.name;
+        if (seen[key(m.name)] > 1)
+        {
+            size_t dot = name.rfind('.');
+            if (dot == std::string::npos || dot == 0 || m.isDir)
+                dot = name.size();
+            name.insert(dot, " [" + std::to_string(m.id) + "]");
+        }
+        out->emplace_back(name, m);
+    }
+    g_searches.put(query, out, complete);
+    return out;
+}
+
+// Classify a path of the virtual tree; a path inside a search result is mapped to the real path
+static VirtualKind classify(const std::string& path, std::string& real)
+{
+    if (path != VIRTUAL_ROOT && path.compare(0, VIRTUAL_ROOT.size() + 1, VIRTUAL_ROOT + "/") != 0)
+        return VirtualKind::None;
+    if (path == VIRTUAL_ROOT || path == SEARCH_DIR)
+        return VirtualKind::Folder;
+    if (path == STATS_FILE)
+        return VirtualKind::Stats;
+    if (path.compare(0, SEARCH_DIR.size() + 1, SEARCH_DIR + "/") != 0)
+        return VirtualKind::Missing;
+    auto parts = CUrlTools::splitPath(path.substr(SEARCH_DIR.size() + 1));
+    NameIndex::Query q;
+    if (parts.empty() || !NameIndex::Query::parse(parts[0], q))
+        return VirtualKind::Missing;
+    if (parts.size() == 1)
+        return VirtualKind::Folder;
+    for (auto& r : *searchResults(parts[0]))
+    {
+        if (r.first != parts[1])
+            continue;
+        real = r.second.path;
+        for (size_t i = 2; i < parts.size(); i++)
+            real += "/" + parts[i];
+        return VirtualKind::Result;
+    }
+    return VirtualKind::Missing;
+}
+
+static bool isVirtual(const char* path)
+{
+    std::string real;
+    return classify(path, real) != VirtualKind::None;
+}
+
+static std::string statsReport()
+{
+    std::string history = g_history ? "access history: " + std::to_string(g_history->size()) + " paths\n" : "";
+    return (g_cache ? g_cache->report() : "content cache: off\n") + history + FJAccess::transport_report();
+}
+
+// Changes with every new upload of the content, so a cached copy of an older version is never served
+static uint64_t contentVersion(const FileInfo& e)
+{
+    return (((uint64_t)e.updated_at.dwHighDateTime << 32) | e.updated_at.dwLowDateTime) ^ e.size;
+}
+
+// Files the shell opens to render thumbnails or icons, or to detect the type
+static bool hasPreview(const std::string& name)
+{
+    static const std::unordered_set<std::string> extensions = {
+        "jpg", "jpeg", "png", "gif", "bmp", "tif", "tiff", "webp", "heic", "ico", "svg",
+        "mp4", "mkv", "avi", "mov", "wmv", "m4v", "webm", "mp3", "flac", "m4a", "wav",
+        "pdf", "doc", "docx", "xls", "xlsx", "ppt", "pptx", "exe", "dll", "lnk", "url" };
+    size_t dot = name.rfind('.');
+    if (dot == std::string::npos)
+        return false;
+    std::string ext = name.substr(dot + 1);
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    return extensions.count(ext) != 0;
+}
+
+// Read the heads of the files of a listing in the background when the folder is mostly previewable files,
+// which Explorer opens one after another to draw thumbnails
+static void prefetchHeads(const std::list<FileInfo>& entries)
+{
+    if (!g_heads || g_stopping)
+        return;
+    size_t files = 0, previews = 0;
+    for (auto& e : entries)
+    {
+        if (e.isDir)
+            continue;
+        files++;
+        if (hasPreview(e.name))
+            previews++;
+    }
+    if (files == 0 || previews * 4 < files)
+        return;
+    size_t queued = 0;
+    std::lock_guard<std::mutex> lk(g_heads_mutex);
+    for (auto& e : entries)
+    {
+        if (e.isDir || e.size == 0 || queued >= 256)
+            continue;
+        uint64_t version = contentVersion(e);
+        if (g_heads->contains(e.id, version) || !g_headsPending.insert(e.id).second)
+            continue;
+        queued++;
+        int id = e.id;
+        uint64_t length = std::min<uint64_t>(e.size, g_heads->headSize());
+        g_headPool->submit([id, version, length]
+            {
+                std::string data;
+                if (!g_stopping && FJAccess::getInstance()->readFile(id, 0, length, data) && data.size() == length)
+                    g_heads->put(id, version, std::move(data));
+                std::lock_guard<std::mutex> lk(g_heads_mutex);
+                g_headsPending.erase(id);
+            });
+    }
+}
+
+static void fillStat(const FileInfo& e, struct fuse_stat* st)
+{
+    st->st_birthtim = filetime_to_timespec(e.created_at);
+    st->st_ctim = filetime_to_timespec(e.updated_at);
+    st->st_atim = st->st_ctim;
+    st->st_mtim = st->st_atim;
+    if (e.isDir)
+    {
+        st->st_mode = S_IFDIR | 0777;
+        st->st_nlink = 2;
+        st->st_size = (off_t)0;
+    }
+    else
+    {
+        st->st_mode = S_IFREG | 0777;
+        st->st_nlink = 1;
+        st->st_size = (off_t)e.size;
+    }
+}
+
+/**
+    @class AttrTable
+    @brief Class keeps ready-made stat results by path, so a warm getattr is one hash probe;
+    @details Filled by readdir and by getattr misses with the stats of remote entries. Entries are dropped
+             on local mutations and reported remote changes, and expire after TTL_MS; get() returns
+             expired ones on request, for when the server cannot be reached.
+**/
+class AttrTable
+{
+private:
+    static const size_t STRIPES = 64;
+    static const size_t MAX_PER_STRIPE = 4096;
+    static const uint64_t TTL_MS = 30000;
+    struct Entry
+    {
+        std::string path;           // compared on lookup, so a hash collision is a miss
+        struct fuse_stat st;
+        uint64_t expires;
+    };
+    struct Stripe
+    {
+        std::shared_mutex m_mutex;
+        std::unordered_map<uint64_t, Entry> entries;
+    };
+    Stripe stripes[STRIPES];
+
+    // FNV-1a
+    static uint64_t hash(const char* path, size_t length)
+    {
+        uint64_t h = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++)
+        {
+            h ^= (unsigned char)path[i];
+            h *= 1099511628211ull;
+        }
+        return h;
+    }
+    Stripe& stripe(uint64_t h)
+    {
+        return stripes[h >> 58];
+    }
+public:
+    bool get(const char* path, struct fuse_stat* st, bool expired = false)
+    {
+        size_t length = strlen(path);
+        uint64_t h = hash(path, length);
+        Stripe& s = stripe(h);
+        std::shared_lock<std::shared_mutex> lock(s.m_mutex);
+        auto it = s.entries.find(h);
+        if (it == s.entries.end() || (!expired && it->second.expires < GetTickCount64()) ||
+            it->second.path.size() != length || memcmp(it->second.path.data(), path, length) != 0)
+            return false;
+        *st = it->second.st;
+        return true;
+    }
+    void put(const std::string& path, const struct fuse_stat& st)
+    {
+        uint64_t h = hash(path.data(), path.size());
+        Stripe& s = stripe(h);
+        std::unique_lock<std::shared_mutex> lock(s.m_mutex);
+        if (s.entries.size() >= MAX_PER_STRIPE)
+            s.entries.clear();
+        s.entries[h] = { path, st, GetTickCount64() + TTL_MS };
+    }
+    void remove(const std::string& path)
+    {
+        uint64_t h = hash(path.data(), path.size());
+        Stripe& s = stripe(h);
+        std::unique_lock<std::shared_mutex> lock(s.m_mutex);
+        s.entries.erase(h);
+    }
+    // The path and everything under it
+    void removeTree(const std::string& path)
+    {
+        remove(path);
+        std::string prefix = path + "/";
+        for (auto& s : stripes)
+        {
+            std::unique_lock<std::shared_mutex> lock(s.m_mutex);
+            for (auto it = s.entries.begin(); it != s.entries.end(); )
+                it = it->second.path.compare(0, prefix.size(), prefix) == 0 ? s.entries.erase(it) : std::next(it);
+        }
+    }
+};
+
+/**
+    @class WriteBack
+    @brief Class delays the upload of released files and coalesces repeated saves of the same path;
+    @details A dirty release hands its local file over; the file is uploaded once the path was not
+             released again for the debounce interval. A newer release replaces the waiting file and
+             cancels an upload of the path in progress. flush() uploads a path at once and waits,
+             the destructor uploads everything left. One worker thread uploads in due order.
+             A failed upload never loses the content: it stays queued and is tried again after
+             RETRY_MS, doubling up to MAX_RETRY_MS while the server answers, and every RETRY_MS
+             while it is not available. The local file is only removed once uploaded or replaced
+             by a newer save or a delete. Submitted files are moved into the queue folder and the
+             list of waiting paths is kept in its index file, so content left at shutdown (or by a
+             crash) is uploaded at the next mount; names of files already there are never reused.
+**/
+class WriteBack
+{
+public:
+    // Uploads local as path; must give up when cancel is set
+    using Upload = std::function<bool(const std::string& path, const std::string& local, const CancellationToken& cancel)>;
+    // Whether the server can be reached; a failed upload is retried sooner when it cannot
+    using Available = std::function<bool()>;
+private:
+    static const uint64_t RETRY_MS = 5000;
+    static const uint64_t MAX_RETRY_MS = 300000;
+    struct Pending
+    {
+        std::string local;
+        uint64_t due;
+        uint64_t generation;
+        std::shared_ptr<CancellationToken> cancel;
+        unsigned attempts = 0;
+    };
+    std::map<std::string, Pending> pending;
+    std::map<std::string, std::string> kept;        // path -> local file of an upload that failed at shutdown
+    std::unordered_map<std::string, std::shared_ptr<CancellationToken>> running;    // path -> its upload's token
+    std::string m_dir;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::condition_variable m_done;
+    std::thread worker;
+    Upload m_upload;
+    Available m_available;
+    uint64_t m_delay;
+    uint64_t nextGeneration = 0;
+    bool stopping = false;
+
+    static void discard(const std::string& local)
+    {
+        std::error_code ec;
+        fs::remove(local, ec);
+    }
+
+    // Index of the queue: one "file<TAB>path" line per waiting upload
+    std::string indexFile() const
+    {
+        return m_dir + "/queue";
+    }
+    // Caller holds m_mutex; the index is replaced in one rename, a crash leaves the old or the new one
+    void save()
+    {
+        std::string tmp = indexFile() + ".tmp";
+        {
+            std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+            if (!ofs.is_open())
+                return;
+            for (auto& p : pending)
+                ofs << fs::path(p.second.local).filename().string() << '\t' << p.first << '\n';
+            for (auto& k : kept)
+                ofs << fs::path(k.second).filename().string() << '\t' << k.first << '\n';
+        }
+        std::error_code ec;
+        fs::rename(tmp, indexFile(), ec);
+    }
+    // Queue the uploads left by the last mount; new files are numbered after every file in the folder
+    void load()
+    {
+        std::error_code ec;
+        for (auto& e : fs::directory_iterator(m_dir, ec))
+        {
+            std::string name = e.path().filename().string();
+            if (!name.empty() && name.size() < 20 && name.find_first_not_of("0123456789") == std::string::npos)
+                nextGeneration = std::max<uint64_t>(nextGeneration, std::stoull(name) + 1);
+        }
+        std::ifstream ifs(indexFile(), std::ios::binary);
+        std::string line;
+        while (std::getline(ifs, line))
+        {
+            size_t tab = line.find('\t');
+            if (tab == std::string::npos || tab + 1 >= line.size())
+                continue;
+            std::string local = m_dir + "/" + line.substr(0, tab);
+            if (!fs::exists(local, ec))
+                continue;
+            std::string path = line.substr(tab + 1);
+            fprintf(stderr, "upload of %s resumed from the last mount\n", path.c_str());
+            pending[path] = { local, 0, nextGeneration++, std::make_shared<CancellationToken>() };
+        }
+    }
+    // Move local into the queue folder under a new name; keeps it where it is when it cannot be moved
+    std::string adopt(const std::string& local, uint64_t generation)
+    {
+        std::string target = m_dir + "/" + std::to_string(generation);
+        std::error_code ec;
+        fs::rename(local, target, ec);
+        if (!ec)
+            return target;
+        fs::copy_file(local, target, fs::copy_options::overwrite_existing, ec);
+        if (ec)
+            return local;
+        fs::remove(local, ec);
+        return target;
+    }
+
+    // Doubles with every failed attempt, up to MAX_RETRY_MS
+    static uint64_t retryDelay(unsigned attempts)
+    {
+        uint64_t delay = RETRY_MS;
+        while (--attempts && delay < MAX_RETRY_MS)
+            delay *= 2;
+        return delay < MAX_RETRY_MS ? delay : MAX_RETRY_MS;
+    }
+
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            uint64_t now = GetTickCount64();
+            auto next = pending.end();
+            for (auto it = pending.begin(); it != pending.end(); ++it)
+                if (!running.count(it->first) && (next == pending.end() || it->second.due < next->second.due))
+                    next = it;
+            if (next == pending.end() || (next->second.due > now && !stopping))
+            {
+                if (stopping && pending.empty())
+                    return;
+                if (next == pending.end())
+                    m_wake.wait(lock);
+                else
+                    m_wake.wait_for(lock, std::chrono::milliseconds(next->second.due - now));
+                continue;
+            }
+            std::string path = next->first;
+            Pending job = next->second;
+            running[path] = job.cancel;
+            lock.unlock();
+            bool ok = m_upload(path, job.local, *job.cancel);
+            bool cancelled = job.cancel->cancelled();
+            bool offline = !ok && !cancelled && !m_available();
+            lock.lock();
+            running.erase(path);
+            auto it = pending.find(path);
+            bool current = it != pending.end() && it->second.generation == job.generation;
+            if (ok || cancelled || !current)
+            {
+                // uploaded, or replaced by a newer save or a delete
+                if (!ok)
+                    fprintf(stderr, "upload of %s superseded\n", path.c_str());
+                discard(job.local);
+                if (current)
+                    pending.erase(it);
+                save();
+            }
+            else if (!stopping)
+            {
+                it->second.attempts++;
+                it->second.due = GetTickCount64() + retryDelay(offline ? 1 : it->second.attempts);
+                if (it->second.attempts == 1)
+                    fprintf(stderr, "upload of %s failed; retrying\n", path.c_str());
+            }
+            else
+            {
+                fprintf(stderr, "upload of %s failed; content kept in %s for the next mount\n", path.c_str(), job.local.c_str());
+                kept[path] = job.local;
+                pending.erase(it);
+                save();
+            }
+            m_done.notify_all();
+        }
+    }
+public:
+    WriteBack(const std::string& dir, unsigned delaySeconds, Upload upload, Available available)
+        : m_dir(dir), m_upload(std::move(upload)), m_available(std::move(available)), m_delay(delaySeconds * 1000ULL)
+    {
+        std::error_code ec;
+        fs::create_directories(m_dir, ec);
+        load();
+        worker = std::thread([this] { run(); });
+    }
+    ~WriteBack()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            stopping = true;
+        }
+        m_wake.notify_all();
+        worker.join();
+    }
+    // Take over local as the newest content of path
+    void submit(const std::string& path, const std::string& local)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = pending.find(path);
+        auto run = running.find(path);
+        if (run != running.end())
+            run->second->cancel();
+        // the file of a running upload is removed by the worker
+        if (it != pending.end() && (run == running.end() || run->second != it->second.cancel))
+            discard(it->second.local);
+        uint64_t generation = nextGeneration++;
+        pending[path] = { adopt(local, generation), GetTickCount64() + m_delay, generation, std::make_shared<CancellationToken>() };
+        save();
+        m_wake.notify_all();
+    }
+    // Saved files wait for the debounce interval; without one they are only queued while the server is not available
+    bool delayed() const
+    {
+        return m_delay != 0;
+    }
+    // Upload the waiting content of path now and wait until it is uploaded, or kept for a retry.
+    // Returns false when the upload failed and the content is still waiting
+    bool flush(const std::string& path)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        auto it = pending.find(path);
+        if (it == pending.end())
+            return true;
+        it->second.due = 0;
+        uint64_t generation = it->second.generation;
+        unsigned attempts = it->second.attempts;
+        m_wake.notify_all();
+        m_done.wait(lock, [&]
+            {
+                auto p = pending.find(path);
+                return p == pending.end() || p->second.generation != generation || p->second.attempts != attempts;
+            });
+        auto p = pending.find(path);
+        return p == pending.end() || p->second.generation != generation;
+    }
+    // Drop the waiting content of path and cancel its upload; used when the path is deleted.
+    // Returns false when nothing was waiting
+    bool cancel(const std::string& path)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto run = running.find(path);
+        if (run != running.end())
+            run->second->cancel();
+        auto it = pending.find(path);
+        if (it == pending.end())
+            return false;
+        if (run == running.end() || run->second != it->second.cancel)
+        {
+            discard(it->second.local);
+            pending.erase(it);
+            save();
+        }
+        return true;
+    }
+    // Size of the content waiting for upload
+    bool size(const std::string& path, uint64_t& size)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = pending.find(path);
+        if (it == pending.end())
+            return false;
+        std::error_code ec;
+        size = fs::file_size(it->second.local, ec);
+        return !ec;
+    }
+    // Copy the content waiting for upload to dest
+    bool copy(const std::string& path, const std::string& dest)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = pending.find(path);
+        if (it == pending.end())
+            return false;
+        std::error_code ec;
+        fs::copy_file(it->second.local, dest, fs::copy_options::overwrite_existing, ec);
+        return !ec;
+    }
+    // Names of the paths waiting for upload directly in folder dir
+    std::vector<std::string> names(const std::string& dir)
+    {
+        std::vector<std::string> out;
+        std::string prefix = dir == "/" ? dir : dir + "/";
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto& p : pending)
+            if (p.first.compare(0, prefix.size(), prefix) == 0 && p.first.find('/', prefix.size()) == std::string::npos)
+                out.push_back(p.first.substr(prefix.size()));
+        return out;
+    }
+};
+
+static AttrTable g_attrs;
+static WriteBack* g_writeBack = nullptr;
+
+/**
+    @class LocalFiles
+    @brief Class keeps files with temporary or local-only names on the local disk instead of FileJump;
+    @details Names matching a local-only pattern (Office owner files, editor swap files, Finder and Explorer
+             metadata) are never uploaded. Names matching a temporary pattern are what applications write
+             before renaming over the original; such a file is uploaded once, as the target of that rename,
+             or at unmount when it still exists. A remote file renamed to a local name (the backup step of
+             an atomic save) becomes an alias: the remote path is hidden, nothing is transferred, and
+             renaming it back or deleting it is applied to the remote file.
+**/
+class LocalFiles
+{
+public:
+    struct Entry
+    {
+        std::string local;      // content on the local disk; empty for an alias not read yet
+        FileInfo remote;        // remote file of an alias, id 0 otherwise
+        std::string hides;      // remote path hidden by an alias
+        bool temporary = false;
+    };
+private:
+    std::vector<std::string> localOnly = { "~$*", "*.swp", "*.swx", ".~lock.*", ".ds_store", "._*", "thumbs.db", "desktop.ini" };
+    std::vector<std::string> temporary = { "*.tmp", "*.temp", "~*.tmp", "*.~tmp", "*.crdownload", "*.part" };
+    std::map<std::string, Entry> files;
+    std::set<std::string> hidden;
+    std::string m_dir;
+    uint64_t next = 0;
+    std::mutex m_mutex;
+
+    static bool matches(const std::vector<std::string>& patterns, std::string name)
+    {
+        std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+        for (auto& p : patterns)
+            if (NameIndex::globMatch(name.data(), name.size(), p.data(), p.size()))
+                return true;
+        return false;
+    }
+public:
+    void setDir(const std::string& dir)
+    {
+        m_dir = dir;
+        std::error_code ec;
+        fs::remove_all(m_dir, ec);
+        fs::create_directories(m_dir, ec);
+    }
+    void addPattern(std::string pattern)
+    {
+        std::transform(pattern.begin(), pattern.end(), pattern.begin(), ::tolower);
+        localOnly.push_back(pattern);
+    }
+    // Whether files named name are kept locally; temporary tells if they are uploaded when renamed
+    bool isLocal(const std::string& name, bool& isTemporary) const
+    {
+        isTemporary = false;
+        if (matches(localOnly, name))
+            return true;
+        isTemporary = matches(temporary, name);
+        return isTemporary;
+    }
+    // New empty local file for path; a file already there is replaced, an alias keeps hiding its remote file
+    bool create(const std::string& path, bool isTemporary, Entry& out)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        out = Entry();
+        auto it = files.find(path);
+        if (it != files.end())
+        {
+            std::error_code ec;
+            if (!it->second.local.empty())
+                fs::remove(it->second.local, ec);
+            out.hides = it->second.hides;
+        }
+        out.local = m_dir + "/" + std::to_string(next++);
+        out.temporary = isTemporary;
+        std::ofstream ofs(out.local, std::ios::binary | std::ios::trunc);
+        if (!ofs.is_open())
+            return false;
+        files[path] = out;
+        return true;
+    }
+    bool find(const std::string& path, Entry& out)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = files.find(path);
+        if (it == files.end())
+            return false;
+        out = it->second;
+        return true;
+    }
+    // Path for the content of an alias that is read for the first time
+    std::string newFile()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_dir + "/" + std::to_string(next++);
+    }
+    void setContent(const std::string& path, const std::string& local)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = files.find(path);
+        if (it != files.end())
+            it->second.local = local;
+    }
+    // Put an entry taken out by take() back, when what it was taken for failed
+    void restore(const std::string& path, const Entry& entry)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        files[path] = entry;
+        if (!entry.hides.empty())
+            hidden.insert(entry.hides);
+    }
+    // Take the entry of path out; the caller owns its local file
+    bool take(const std::string& path, Entry& out)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = files.find(path);
+        if (it == files.end())
+            return false;
+        out = it->second;
+        files.erase(it);
+        if (!out.hides.empty())
+            hidden.erase(out.hides);
+        return true;
+    }
+    // Move an entry to another local name; an entry already there is returned in replaced
+    bool move(const std::string& from, const std::string& to, Entry& replaced)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = files.find(from);
+        if (it == files.end())
+            return false;
+        bool isTemporary = false;
+        isLocal(CUrlTools::getName(to), isTemporary);
+        Entry e = it->second;
+        e.temporary = isTemporary;
+        files.erase(it);
+        auto old = files.find(to);
+        replaced = old != files.end() ? old->second : Entry();
+        if (old != files.end() && !old->second.hides.empty())
+            hidden.erase(old->second.hides);
+        files[to] = e;
+        return true;
+    }
+    // Hide the remote file at remotePath behind the local name path
+    void alias(const std::string& path, const std::string& remotePath, const FileInfo& remote)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        Entry e;
+        e.remote = remote;
+        e.hides = remotePath;
+        files[path] = e;
+        hidden.insert(remotePath);
+    }
+    bool isHidden(const std::string& path)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return hidden.count(path) != 0;
+    }
+    // A hidden remote file is being replaced: its aliases lose their remote content
+    void replaced(const std::string& remotePath)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (!hidden.erase(remotePath))
+            return;
+        for (auto& f : files)
+            if (f.second.hides == remotePath)
+                f.second.hides.clear();
+    }
+    // Names of the local files directly in folder dir
+    std::vector<std::string> names(const std::string& dir)
+    {
+        std::vector<std::string> out;
+        std::string prefix = dir == "/" ? dir : dir + "/";
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto& f : files)
+            if (f.first.compare(0, prefix.size(), prefix) == 0 && f.first.find('/', prefix.size()) == std::string::npos)
+                out.push_back(f.first.substr(prefix.size()));
+        return out;
+    }
+    // Remove all entries; returns the temporary files with content, to be uploaded
+    std::vector<std::pair<std::string, std::string>> drain()
+    {
+        std::vector<std::pair<std::string, std::string>> out;
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto& f : files)
+            if (f.second.temporary && !f.second.local.empty())
+                out.emplace_back(f.first, f.second.local);
+        files.clear();
+        hidden.clear();
+        return out;
+    }
+};
+
+static LocalFiles g_local;
+
+static void fillLocalStat(const LocalFiles::Entry& local, struct fuse_stat* st)
+{
+    if (local.local.empty())
+    {
+        fillStat(local.remote, st);
+        return;
+    }
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    std::error_code ec;
+    st->st_mode = S_IFREG | 0777;
+    st->st_nlink = 1;
+    st->st_size = (fuse_off_t)fs::file_size(local.local, ec);
+    st->st_mtim = st->st_ctim = st->st_atim = filetime_to_timespec(now);
+}
+
+// Content saved but not uploaded yet: its size, and the current time as it is still changing
+static void fillWaitingStat(uint64_t size, struct fuse_stat* st)
+{
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    st->st_mode = S_IFREG | 0777;
+    st->st_nlink = 1;
+    st->st_size = (fuse_off_t)size;
+    st->st_mtim = st->st_ctim = st->st_atim = filetime_to_timespec(now);
+}
+
 static int fj_getattr(const char* path, struct fuse_stat* stbuf, struct fuse_file_info* fi) {
     (void)fi;
+    OpDeadline deadline;
     if(verbose)
         fprintf(stderr, "getattr: %s\n", path);
     memset(stbuf, 0, sizeof(struct stat));
@@ -107,25 +997,48 @@ static int fj_getattr(const char* path, struct fuse_stat* stbuf, struct fuse_fil
         stbuf->st_size = (off_t)0;
         return 0;
     }
-    FJAccess* access = FJAccess::getInstance();
-    const struct FileInfo *entry = access->findFile(path);
-    if (!entry) 
+    LocalFiles::Entry local;
+    if (g_local.find(path, local))
+    {
+        fillLocalStat(local, stbuf);
+        return 0;
+    }
+    if (g_local.isHidden(path))
         return -ENOENT;
-    stbuf->st_birthtim = filetime_to_timespec(entry->created_at);
-    stbuf->st_ctim = filetime_to_timespec(entry->updated_at);
-    stbuf->st_atim = stbuf->st_ctim;
-    stbuf->st_mtim = stbuf->st_atim;
-
-    if (entry->isDir) {
-        stbuf->st_mode = S_IFDIR | 0777;
-        stbuf->st_nlink = 2;
-        stbuf->st_size = (off_t)0;
+    uint64_t waiting = 0;
+    if (g_writeBack && g_writeBack->size(path, waiting))
+    {
+        fillWaitingStat(waiting, stbuf);
+        return 0;
     }
-    else {
-        stbuf->st_mode = S_IFREG | 0777;
+    // while the server is not available, expired attributes are better than none
+    if (g_attrs.get(path, stbuf) || (!FJAccess::online() && g_attrs.get(path, stbuf, true)))
+        return 0;
+    std::string real = path;
+    VirtualKind kind = classify(path, real);
+    switch (kind)
+    {
+    case VirtualKind::Folder:
+        stbuf->st_mode = S_IFDIR | 0555;
+        stbuf->st_nlink = 2;
+        return 0;
+    case VirtualKind::Stats:
+        stbuf->st_mode = S_IFREG | 0444;
         stbuf->st_nlink = 1;
-        stbuf->st_size = (off_t)entry->size;
+        stbuf->st_size = (fuse_off_t)statsReport().size();
+        return 0;
+    case VirtualKind::Missing:
+        return -ENOENT;
+    default:
+        break;
     }
+    FJAccess* access = FJAccess::getInstance();
+    const struct FileInfo *entry = access->findFile(real);
+    if (!entry) 
+        return -ENOENT;
+    fillStat(*entry, stbuf);
+    if (kind == VirtualKind::None)
+        g_attrs.put(path, *stbuf);
     delete entry;
     return 0;
 }
@@ -137,31 +1050,84 @@ static int fj_readdir(const char* path, void* buf, fuse_fill_dir_t filler,
 	(void)flags;
     if (verbose)
         fprintf(stderr, "readdir: %s\n", path);
+    OpDeadline deadline;
     filler(buf, ".", NULL, 0, (fuse_fill_dir_flags)0);
     filler(buf, "..", NULL, 0, (fuse_fill_dir_flags)0);
     //std::string p = norm(path);
 
-    FJAccess* access = FJAccess::getInstance();
-    int dir_id = access->getDirectoryID(path);
-    auto entries = access->getDirectoryContent(dir_id);
-    // list unique names (FileJump may allow duplicates)
-    for (auto& e : entries) {
-        struct fuse_stat st = { 0 };
-        st.st_birthtim = filetime_to_timespec(e.created_at);
-        st.st_ctim = filetime_to_timespec(e.updated_at);
-        st.st_atim = st.st_ctim;
-        st.st_mtim = st.st_atim;
-        if (e.isDir)
+    std::string real = path;
+    std::list<FileInfo> entries;
+    VirtualKind kind = classify(path, real);
+    switch (kind)
+    {
+    case VirtualKind::Folder:
+        if (path == VIRTUAL_ROOT)
         {
-            st.st_mode = S_IFDIR | 0777;
-            st.st_nlink = 2;
+            filler(buf, "search", NULL, 0, (fuse_fill_dir_flags)0);
+            filler(buf, "stats", NULL, 0, (fuse_fill_dir_flags)0);
         }
-        else 
+        else if (path != SEARCH_DIR)
         {
-            st.st_mode = S_IFREG | 0777;
-            st.st_nlink = 1;
-            st.st_size = (off_t)e.size;
+            for (auto& r : *searchResults(CUrlTools::getName(path)))
+            {
+                FileInfo e;
+                e.name = r.first;
+                e.id = r.second.id;
+                e.size = r.second.size;
+                e.isDir = r.second.isDir;
+                e.created_at = { (DWORD)r.second.created, (DWORD)(r.second.created >> 32) };
+                e.updated_at = { (DWORD)r.second.modified, (DWORD)(r.second.modified >> 32) };
+                entries.push_back(e);
+            }
         }
+        break;
+    case VirtualKind::Stats:
+        return -ENOTDIR;
+    case VirtualKind::Missing:
+        return -ENOENT;
+    default:
+    {
+        FJAccess* access = FJAccess::getInstance();
+        int dir_id = access->getDirectoryID(real);
+        entries = access->getDirectoryContent(dir_id);
+        prefetchHeads(entries);
+        if (g_history)
+            g_history->touch(path, true);
+        std::string dir = strcmp(path, "/") == 0 ? "" : path;
+        // saved files not uploaded yet are listed as getattr reports them, and not put in g_attrs
+        if (g_writeBack)
+        {
+            for (auto& name : g_writeBack->names(path))
+            {
+                uint64_t size = 0;
+                if (std::any_of(entries.begin(), entries.end(), [&](const FileInfo& e) { return e.name == name; }) ||
+                    g_local.isHidden(dir + "/" + name) || !g_writeBack->size(dir + "/" + name, size))
+                    continue;
+                struct fuse_stat st = { 0 };
+                fillWaitingStat(size, &st);
+                filler(buf, name.c_str(), &st, 0, (fuse_fill_dir_flags)0);
+            }
+        }
+        entries.remove_if([&](const FileInfo& e) { return g_local.isHidden(dir + "/" + e.name); });
+        for (auto& name : g_local.names(path))
+        {
+            LocalFiles::Entry local;
+            if (!g_local.find(dir + "/" + name, local))
+                continue;
+            struct fuse_stat st = { 0 };
+            fillLocalStat(local, &st);
+            filler(buf, name.c_str(), &st, 0, (fuse_fill_dir_flags)0);
+        }
+    }
+    }
+    bool remote = kind == VirtualKind::None;
+    std::string prefix = strcmp(path, "/") == 0 ? "" : path;
+    // list unique names (FileJump may allow duplicates)
+    for (auto& e : entries) {
+        struct fuse_stat st = { 0 };
+        fillStat(e, &st);
+        if (remote)
+            g_attrs.put(prefix + "/" + e.name, st);
         filler(buf, e.name.c_str(), &st, 0, (fuse_fill_dir_flags)0);
     }
     return 0;
@@ -171,6 +1137,24 @@ static int fj_create(const char* path, fuse_mode_t mode, struct fuse_file_info*
 
     if (verbose)
         fprintf(stderr, "create: %s\n", path);
+    if (isVirtual(path))
+        return -EACCES;
+
+    bool temporary;
+    if (g_local.isLocal(CUrlTools::getName(path), temporary))
+    {
+        LocalFiles::Entry local;
+        if (!g_local.create(path, temporary, local))
+            return -EIO;
+        std::lock_guard<std::mutex> lk(g_handles_mutex);
+        uint64_t handle = g_next_handle++;
+        HandleInfo hi;
+        hi.localPath = local.local;
+        hi.localOnly = true;
+        g_handles[handle] = hi;
+        fi->fh = handle;
+        return 0;
+    }
     
     // Check if file already exists
     FJAccess* access = FJAccess::getInstance();
@@ -214,6 +1198,48 @@ static int fj_open(const char* path, struct fuse_file_info* fi)
 {
     if (verbose)
         fprintf(stderr, "open: %s\n", path);
+    OpDeadline deadline;
+    std::string real = path;
+    VirtualKind kind = classify(path, real);
+    if (kind == VirtualKind::Missing || kind == VirtualKind::Folder)
+        return -ENOENT;
+    bool writing = (fi->flags & (O_WRONLY | O_RDWR | O_TRUNC | O_CREAT)) != 0;
+    if ((kind == VirtualKind::Result || kind == VirtualKind::Stats) && writing)
+        return -EACCES;
+    if (kind == VirtualKind::None)
+    {
+        LocalFiles::Entry local;
+        bool temporary;
+        if (!g_local.find(path, local))
+        {
+            if (!(fi->flags & O_CREAT) || !g_local.isLocal(CUrlTools::getName(path), temporary))
+                local.local.clear();
+            else if (!g_local.create(path, temporary, local))
+                return -EIO;
+        }
+        else if (local.local.empty())
+        {
+            // first open of an alias: fetch the remote file it stands for
+            std::string file = g_local.newFile();
+            if (!FJAccess::getInstance()->copyFile(local.remote.id, file))
+                return -EIO;
+            g_local.setContent(path, file);
+            local.local = file;
+        }
+        if (!local.local.empty())
+        {
+            if (fi->flags & O_TRUNC)
+                std::ofstream(local.local, std::ios::binary | std::ios::trunc);
+            std::lock_guard<std::mutex> lk(g_handles_mutex);
+            uint64_t handle = g_next_handle++;
+            HandleInfo hi;
+            hi.localPath = local.local;
+            hi.localOnly = true;
+            g_handles[handle] = hi;
+            fi->fh = handle;
+            return 0;
+        }
+    }
     std::lock_guard<std::mutex> lk(g_handles_mutex);
     uint64_t handle = g_next_handle++;
     std::string remote = norm(path);
@@ -221,19 +1247,43 @@ static int fj_open(const char* path, struct fuse_file_info* fi)
     fs::path p(tmp);
     fs::create_directories(p.parent_path());
 
+    HandleInfo hi;
+    hi.localPath = tmp;
+    hi.dirty = false;
+    hi.writable = writing;
     bool createEmpty = (fi->flags & O_TRUNC) || (fi->flags & O_CREAT);
-    if (!createEmpty) 
+    if (kind == VirtualKind::Stats)
+    {
+        std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+        ofs << statsReport();
+    }
+    else if (!createEmpty && g_writeBack && g_writeBack->copy(path, tmp))
+    {
+        // the newest content is still waiting for upload
+    }
+    else if (!createEmpty) 
     {
         FJAccess* access = FJAccess::getInstance();
-        const struct FileInfo *entry = access->findFile(path);
+        const struct FileInfo *entry = access->findFile(real);
         if (entry)
         {
-            bool ok = access->copyFile(entry->id, tmp);
-            // try to download existing file; if fails, create empty
-            if (!ok)
+            if (g_history && kind == VirtualKind::None)
+                g_history->touch(path, false);
+            // read-only opens share the cached copy; a copy that is written to stays private
+            std::string cached;
+            if (g_cache && !writing)
+                cached = g_cache->acquire(entry->id, contentVersion(*entry));
+            if (!cached.empty())
+            {
+                hi.localPath = cached;
+                hi.cached = true;
+            }
+            else
             {
-                std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
-                ofs.close();
+                // nothing is downloaded until the first read or write, many opens only query the file
+                hi.id = entry->id;
+                hi.version = contentVersion(*entry);
+                hi.size = entry->size;
             }
             delete entry;
         }
@@ -243,23 +1293,124 @@ static int fj_open(const char* path, struct fuse_file_info* fi)
         ofs.close();
     }
 
-    HandleInfo hi;
-    hi.localPath = tmp;
-    hi.dirty = false;
     g_handles[handle] = hi;
     fi->fh = handle;
     return 0;
 }
 
+// Download the whole content of a handle opened without it; g_handles_mutex must not be held
+static bool fetchContent(uint64_t handle)
+{
+    std::unique_lock<std::mutex> lk(g_handles_mutex);
+    auto it = g_handles.find(handle);
+    if (it == g_handles.end())
+        return false;
+    if (!it->second.id)
+        return true;
+    auto fetch = it->second.fetch;
+    lk.unlock();
+
+    // concurrent reads of the same handle download once
+    std::lock_guard<std::mutex> fetching(*fetch);
+    lk.lock();
+    it = g_handles.find(handle);
+    if (it == g_handles.end())
+        return false;
+    if (!it->second.id)
+        return true;
+    HandleInfo hi = it->second;
+    lk.unlock();
+
+    // a whole download may take longer than one operation, only the release of the handle stops it
+    CancellationToken::Scope scope(hi.cancel.get());
+    if (verbose)
+        fprintf(stderr, "fetch: entry %d, %llu bytes\n", hi.id, (unsigned long long)hi.size);
+    if (!FJAccess::getInstance()->copyFile(hi.id, hi.localPath))
+        return false;
+    std::string path = hi.localPath;
+    bool cached = false;
+    if (g_cache && !hi.writable)
+        path = g_cache->admit(hi.id, hi.version, hi.localPath, hi.size, cached);
+
+    lk.lock();
+    it = g_handles.find(handle);
+    if (it == g_handles.end())
+    {
+        // released while downloading
+        if (cached)
+            g_cache->release(path);
+        else
+        {
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+        return false;
+    }
+    it->second.localPath = path;
+    it->second.cached = cached;
+    it->second.id = 0;
+    it->second.buffer.clear();
+    return true;
+}
+
 static int fj_read(const char* path, char* buf, size_t size, fuse_off_t offset, struct fuse_file_info* fi) 
 {
     (void)path;
     if (verbose)
         fprintf(stderr, "read: %s\n", path);
     uint64_t handle = fi->fh;
-    std::lock_guard<std::mutex> lk(g_handles_mutex);
+    std::unique_lock<std::mutex> lk(g_handles_mutex);
     auto it = g_handles.find(handle);
     if (it == g_handles.end()) return -EBADF;
+    if (it->second.id)
+    {
+        HandleInfo& hi = it->second;
+        if ((uint64_t)offset >= hi.size)
+            return 0;
+        size_t length = (size_t)std::min<uint64_t>(size, hi.size - offset);
+        size_t got = 0;
+        if (g_heads && g_heads->read(hi.id, hi.version, offset, length, buf, got))
+            return (int)got;
+        if (hi.size <= SMALL_FILE || hi.writable)
+        {
+            lk.unlock();
+            if (!fetchContent(handle))
+                return -EIO;
+            lk.lock();
+            it = g_handles.find(handle);
+            if (it == g_handles.end()) return -EBADF;
+        }
+        else
+        {
+            // large file: serve the range from the last window read, or read a new window
+            if ((uint64_t)offset < hi.bufferOffset || (uint64_t)offset + length > hi.bufferOffset + hi.buffer.size())
+            {
+                int id = hi.id;
+                uint64_t window = std::min<uint64_t>(std::max<uint64_t>(length, READ_WINDOW), hi.size - offset);
+                auto handleToken = hi.cancel;
+                lk.unlock();
+                CancellationToken token(g_opTimeoutMs);
+                CancellationToken::Scope scope(&token);
+                size_t subscription = handleToken->subscribe([&token] { token.cancel(); });
+                std::string data;
+                bool ok = FJAccess::getInstance()->readFile(id, offset, window, data);
+                handleToken->unsubscribe(subscription);
+                if (!ok)
+                    return token.cancelled() ? -EINTR : -EIO;
+                lk.lock();
+                it = g_handles.find(handle);
+                if (it == g_handles.end()) return -EBADF;
+                it->second.bufferOffset = offset;
+                it->second.buffer = std::move(data);
+            }
+            HandleInfo& h = it->second;
+            size_t from = (size_t)(offset - h.bufferOffset);
+            length = std::min(length, h.buffer.size() - std::min(from, h.buffer.size()));
+            if (length)
+                memcpy(buf, h.buffer.data() + from, length);
+            return (int)length;
+        }
+    }
     const std::string& local = it->second.localPath;
 
     std::ifstream ifs(local, std::ios::binary);
@@ -279,6 +1430,8 @@ static int fj_write(const char* path, const char* buf, size_t size, fuse_off_t o
     if (verbose)
         fprintf(stderr, "write: %s\n", path);
     uint64_t handle = fi->fh;
+    if (!fetchContent(handle))
+        return -EIO;
     std::lock_guard<std::mutex> lk(g_handles_mutex);
     auto it = g_handles.find(handle);
     if (it == g_handles.end()) return -EBADF;
@@ -298,40 +1451,114 @@ static int fj_write(const char* path, const char* buf, size_t size, fuse_off_t o
     return (int)size;
 }
 
-static int fj_unlink(const char* path) 
+// Delete the remote file at path
+static int removeRemote(const char* path)
 {
-    if (verbose)
-        fprintf(stderr, "unlink: %s\n", path);
     FJAccess* fj = FJAccess::getInstance();
     const struct FileInfo* entry = fj->findFile(path);
     if (!entry)
         return -ENOENT;
-    const struct FileInfo* parent = fj->findFile(CUrlTools::getParentPath(path));
-    fj->deleteFile(parent->id, entry->id);
+    fj->deleteFile(entry->parent_id > 0 ? entry->parent_id : 0, entry->id);
+    g_attrs.remove(path);
+    if (g_cache)
+        g_cache->remove(entry->id);
+    if (g_heads)
+        g_heads->remove(entry->id);
     delete entry;
-    delete parent;
     return 0;
 }
 
+static int fj_unlink(const char* path) 
+{
+    if (verbose)
+        fprintf(stderr, "unlink: %s\n", path);
+    OpDeadline deadline;
+    if (isVirtual(path))
+        return -EACCES;
+    LocalFiles::Entry local;
+    if (g_local.take(path, local))
+    {
+        std::error_code ec;
+        if (!local.local.empty())
+            fs::remove(local.local, ec);
+        // deleting the alias of a remote file deletes that file
+        if (!local.hides.empty())
+            removeRemote(local.hides.c_str());
+        return 0;
+    }
+    if (g_local.isHidden(path))
+        return -ENOENT;
+    bool waiting = g_writeBack && g_writeBack->cancel(path);
+    int result = removeRemote(path);
+    return waiting && result == -ENOENT ? 0 : result;
+}
+
+// Replace the remote file at path by the content of local
+static bool uploadAs(const std::string& path, const std::string& local, const CancellationToken* cancel)
+{
+    std::string parent = CUrlTools::getParentPath(path);
+    std::string name = CUrlTools::getName(path);
+    FJAccess* fj = FJAccess::getInstance();
+    int parent_id = fj->lookupDirectoryID(parent);
+    if (parent_id < 0)
+    {
+        // not in the directory cache: look the folder up itself
+        const struct FileInfo* entry = fj->findFile(parent);
+        if (entry && entry->isDir)
+            parent_id = entry->id;
+        delete entry;
+    }
+    // without a parent the upload fails, and the caller keeps the local content
+    if (parent_id < 0)
+        return false;
+    // the new content goes up next to the old file, which is deleted only once the upload succeeded:
+    // a failed upload leaves the remote file as it was
+    const struct FileInfo* old = fj->findFile(path);
+    std::string localPath = local;
+    std::replace(localPath.begin(), localPath.end(), '/', '\\');
+    FileInfo uploaded;
+    bool ok = fj->uploadFile(localPath, parent_id, name, &uploaded, "", cancel);
+    if (ok && old && !old->isDir && old->id != uploaded.id)
+    {
+        fj->deleteFile(old->parent_id > 0 ? old->parent_id : 0, old->id);
+        if (g_cache)
+            g_cache->remove(old->id);
+        if (g_heads)
+            g_heads->remove(old->id);
+    }
+    delete old;
+    g_attrs.remove(path);
+    return ok;
+}
+
+// Hands saved content to the write-back queue when uploads are debounced, the server cannot be
+// reached now or the caller's own upload failed; the queue then owns the local file and retries it.
+// Returns false when the caller uploads it itself
+static bool queueUpload(const std::string& path, const std::string& local, bool failed = false)
+{
+    if (!g_writeBack || (!failed && !g_writeBack->delayed() && FJAccess::online()))
+        return false;
+    g_writeBack->submit(path, local);
+    g_attrs.remove(path);
+    return true;
+}
+
 static int fj_mkdir(const char* path, fuse_mode_t mode) 
 {
     (void)mode;
     if (verbose)
         fprintf(stderr, "mkdir: %s\n", path);
+    OpDeadline deadline;
+    if (isVirtual(path))
+        return -EACCES;
 
     std::string parent = CUrlTools::getParentPath(path);
     std::string name = CUrlTools::getName(path);
     FJAccess* fj = FJAccess::getInstance();
-    const struct FileInfo* parent_entry = fj->findFile(parent);
-    if (!parent_entry && parent != "")
-    {
-        if (parent_entry)
-            delete parent_entry;
+    int parent_id = fj->lookupDirectoryID(parent);
+    if (parent_id < 0)
         return -ENOENT;
-    }
-    int parent_id = parent_entry ? parent_entry->id : 0;
     bool success = fj->createDir(parent_id, name);
-    delete parent_entry;
     return success? 0: -ENOENT;
 }
 
@@ -339,6 +1566,9 @@ static int fj_rmdir(const char* path)
 {
     if (verbose)
         fprintf(stderr, "rmdir: %s\n", path);
+    OpDeadline deadline;
+    if (isVirtual(path))
+        return -EACCES;
     FJAccess* access = FJAccess::getInstance();
     // Check if directory exists
     const struct FileInfo* entry = access->findFile(path);
@@ -357,10 +1587,9 @@ static int fj_rmdir(const char* path)
     }
 
     // Delete the directory
-    const struct FileInfo* parent_entry = access->findFile(CUrlTools::getParentPath(path));
-    bool success = access->deleteFile(parent_entry->id, entry->id);  // or deleteDirectory()
+    bool success = access->deleteFile(entry->parent_id > 0 ? entry->parent_id : 0, entry->id);  // or deleteDirectory()
     delete entry;
-    delete parent_entry;
+    g_attrs.removeTree(path);
     if (!success)
     {
         return -EIO;  // I/O error
@@ -368,6 +1597,130 @@ static int fj_rmdir(const char* path)
     return 0;
 }
 
+// Drop a local file that a rename replaced; an alias being replaced deletes the remote file it stood for
+static void discardLocal(const LocalFiles::Entry& local)
+{
+    std::error_code ec;
+    if (!local.local.empty())
+        fs::remove(local.local, ec);
+    if (!local.hides.empty())
+        removeRemote(local.hides.c_str());
+}
+
+// FileJump has no rename; renames that are part of an atomic save are done locally or as one upload,
+// other renames return EXDEV, so Windows copies and deletes instead
+static int fj_rename(const char* from, const char* to, unsigned int flags)
+{
+    (void)flags;
+    if (verbose)
+        fprintf(stderr, "rename: %s -> %s\n", from, to);
+    OpDeadline deadline;
+    if (isVirtual(from) || isVirtual(to))
+        return -EACCES;
+    bool temporary;
+    bool toLocal = g_local.isLocal(CUrlTools::getName(to), temporary);
+    LocalFiles::Entry local;
+    if (g_local.find(from, local))
+    {
+        if (toLocal)
+        {
+            LocalFiles::Entry old;
+            g_local.move(from, to, old);
+            discardLocal(old);
+            return 0;
+        }
+        g_local.take(from, local);
+        g_attrs.remove(to);
+        if (local.local.empty() && local.hides == to)
+            return 0;           // renamed back: nothing changed remotely
+        // a rename that fails leaves from as it was
+        if (local.local.empty())
+        {
+            std::string content = g_local.newFile();
+            if (!FJAccess::getInstance()->copyFile(local.remote.id, content))
+            {
+                std::error_code ec;
+                fs::remove(content, ec);
+                g_local.restore(from, local);
+                return -EIO;
+            }
+            local.local = content;
+        }
+        // the temporary file replaces the target: one upload, the old target is deleted after it
+        if (!queueUpload(to, local.local))
+        {
+            // a failed upload is left to the queue
+            if (uploadAs(to, local.local, nullptr))
+            {
+                std::error_code ec;
+                fs::remove(local.local, ec);
+            }
+            else if (!queueUpload(to, local.local, true))
+            {
+                g_local.restore(from, local);
+                return -EIO;
+            }
+        }
+        g_local.replaced(to);
+        if (!local.hides.empty() && local.hides != to)
+            removeRemote(local.hides.c_str());
+        return 0;
+    }
+    if (g_local.isHidden(from))
+        return -ENOENT;
+    if (!toLocal)
+        return -EXDEV;
+    // a remote file renamed to a temporary name, like the backup step of a save: hide it, transfer nothing
+    if (g_writeBack)
+        g_writeBack->flush(from);
+    const struct FileInfo* entry = FJAccess::getInstance()->findFile(from);
+    if (!entry)
+        return -ENOENT;
+    if (entry->isDir)
+    {
+        delete entry;
+        return -EXDEV;
+    }
+    LocalFiles::Entry old;
+    if (g_local.take(to, old))
+        discardLocal(old);
+    g_local.alias(to, from, *entry);
+    delete entry;
+    g_attrs.remove(from);
+    return 0;
+}
+
+// An explicit fsync uploads the content written so far at once, without waiting for the debounce interval
+static int fj_fsync(const char* path, int datasync, struct fuse_file_info* fi)
+{
+    (void)datasync;
+    if (verbose)
+        fprintf(stderr, "fsync: %s\n", path);
+    if (!g_writeBack)
+        return 0;
+    if (fi && fi->fh)
+    {
+        std::string snapshot;
+        {
+            std::lock_guard<std::mutex> lk(g_handles_mutex);
+            auto it = g_handles.find(fi->fh);
+            if (it != g_handles.end() && it->second.dirty)
+            {
+                snapshot = g_tempDir + "/fj_sync_" + std::to_string(g_next_handle++);
+                std::error_code ec;
+                fs::copy_file(it->second.localPath, snapshot, fs::copy_options::overwrite_existing, ec);
+                if (ec)
+                    return -EIO;
+                it->second.dirty = false;
+            }
+        }
+        if (!snapshot.empty())
+            g_writeBack->submit(path, snapshot);
+    }
+    // a failed upload stays queued for a retry, but the data is not on the server yet
+    return g_writeBack->flush(path) ? 0 : -EIO;
+}
+
 static int fj_release(const char* path, struct fuse_file_info* fi) 
 {
     uint64_t handle = fi->fh;
@@ -381,30 +1734,606 @@ static int fj_release(const char* path, struct fuse_file_info* fi)
         hi = it->second;
         g_handles.erase(it);
     }
+    hi.cancel->cancel();
 
+    if (hi.localOnly)
+        return 0;
     if (hi.dirty) {
-        // delete remote first (to prevent duplicates)
-        fj_unlink(path);
-        std::string parent = CUrlTools::getParentPath(path);
-        std::string name = CUrlTools::getName(path);
-        FJAccess* fj = FJAccess::getInstance();
-        const struct FileInfo* parent_info = fj->findFile(parent);
-        if (parent_info)
-        {
-            std::string localPath = hi.localPath;
-            std::replace(localPath.begin(), localPath.end(), '/', '\\');
-            bool ok = fj->uploadFile(localPath, parent_info->id, name);
-            delete parent_info;
-            if (!ok)
+        if (queueUpload(path, hi.localPath))
+            return 0;
+        // a failed upload is left to the queue
+        if (!uploadAs(path, hi.localPath, nullptr))
+            return queueUpload(path, hi.localPath, true) ? 0 : -EIO;
+    }
+
+    if (hi.cached)
+        g_cache->release(hi.localPath);
+    else
+    {
+        try { fs::remove(hi.localPath); }
+        catch (...) {}
+    }
+    return 0;
+}
+
+// Tell the kernel (WinFsp) about a remote change so its attribute and directory caches drop the path
+static void notifyChange(const std::string& path, const DirectoryChange& change)
+{
+    if (verbose)
+        fprintf(stderr, "remote change %d: %s\n", (int)change.kind, path.c_str());
+    std::string attrPath = path.size() > 1 && path.back() == '/' ? path.substr(0, path.size() - 1) : path;
+    if (change.kind == DirectoryChange::Removed && change.entry.isDir)
+        g_attrs.removeTree(attrPath);
+    else
+        g_attrs.remove(attrPath);
+#ifdef FSP_FUSE_NOTIFY_MKDIR
+    uint32_t action = 0;
+    switch (change.kind)
+    {
+    case DirectoryChange::Added:
+        action = change.entry.isDir ? FSP_FUSE_NOTIFY_MKDIR : FSP_FUSE_NOTIFY_CREATE;
+        break;
+    case DirectoryChange::Removed:
+        action = change.entry.isDir ? FSP_FUSE_NOTIFY_RMDIR : FSP_FUSE_NOTIFY_UNLINK;
+        break;
+    case DirectoryChange::Modified:
+        action = FSP_FUSE_NOTIFY_UTIME | FSP_FUSE_NOTIFY_TRUNCATE;
+        break;
+    }
+    if (g_fuse)
+        fuse_notify(g_fuse, path.c_str(), action);
+#endif
+}
+
+/**
+    @class PinnedFolders
+    @brief Class keeps pinned folders available offline: their listings and file content stay cached and are refreshed in the background;
+    @details Pins are read from a file, one folder path per line (# starts a comment), and are changed through
+             the user.filejump.pinned extended attribute, which writes the file back. One worker thread
+             synchronizes a folder when it is pinned and every interval after that: it walks the folder tree,
+             lists every folder again, keeps the listings out of LRU eviction and downloads new or changed
+             files into the content cache as kept content, the small files of a folder as one archive. What a synchronization no longer finds, and what
+             an unpinned folder held, is returned to the caches' normal eviction.
+**/
+class PinnedFolders
+{
+public:
+    struct Status
+    {
+        std::string root;       // pinned folder covering the path, empty when the path is not pinned
+        FILETIME synced;        // end of its last complete synchronization, zero = never
+        bool syncing;
+        bool failed;            // the last synchronization did not complete
+    };
+private:
+    struct Pin
+    {
+        FILETIME synced = { 0, 0 };
+        uint64_t attempted = 0;             // GetTickCount64 of the last start, 0 = due now
+        bool syncing = false;
+        bool failed = false;
+        std::unordered_set<int> folders;    // kept listings
+        std::unordered_set<int> files;      // kept content
+    };
+    std::map<std::string, Pin> pins;
+    std::string m_file;
+    uint64_t m_interval;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    std::thread worker;
+    CancellationToken m_cancel;
+    bool stopping = false;
+    static constexpr uint64_t ARCHIVE_MAX_FILE = 1 << 20;  // larger files are not fetched in archives, which are held in memory
+
+    static std::string normalize(std::string path)
+    {
+        std::replace(path.begin(), path.end(), '\\', '/');
+        size_t begin = path.find_first_not_of(" \t\r\n");
+        size_t end = path.find_last_not_of(" \t\r\n");
+        path = begin == std::string::npos ? "" : path.substr(begin, end - begin + 1);
+        if (path.empty() || path[0] != '/')
+            path = "/" + path;
+        while (path.size() > 1 && path.back() == '/')
+            path.pop_back();
+        return path;
+    }
+    static bool covers(const std::string& root, const std::string& path)
+    {
+        return root == "/" || path == root || (path.size() > root.size() && path.compare(0, root.size(), root) == 0 && path[root.size()] == '/');
+    }
+    // m_mutex must be held
+    bool save() const
+    {
+        if (m_file.empty())
+            return true;
+        std::ofstream out(m_file, std::ios::trunc);
+        out << "# folders FileJumpFS keeps available offline\n";
+        for (auto& p : pins)
+            out << p.first << "\n";
+        return (bool)out;
+    }
+    static void release(const std::unordered_set<int>& folders, const std::unordered_set<int>& files)
+    {
+        FJAccess* access = FJAccess::getInstance();
+        for (int id : folders)
+            access->keepDirectory(id, false);
+        if (g_cache)
+            for (int id : files)
+                g_cache->keep(id, false);
+    }
+
+    // Admit a downloaded file as kept content; false when the cache could not take it
+    static bool keep(const FileInfo& e, const std::string& tmp)
+    {
+        bool kept = false;
+        std::string path = g_cache->admit(e.id, contentVersion(e), tmp, e.size, kept, true);
+        if (kept)
+            g_cache->release(path);
+        else
+        {
+            std::error_code ec;
+            fs::remove(path, ec);
+        }
+        return kept;
+    }
+
+    // Walk the tree under root, refresh its listings and fetch missing content; false when something failed
+    bool sync(const std::string& root, std::unordered_set<int>& folders, std::unordered_set<int>& files)
+    {
+        CancellationToken::Scope scope(&m_cancel);
+        FJAccess* access = FJAccess::getInstance();
+        int rootId = root == "/" ? 0 : access->lookupDirectoryID(root);
+        if (rootId < 0)
+            return false;
+        std::vector<int> cachedList = access->cachedDirectories();
+        std::unordered_set<int> cached(cachedList.begin(), cachedList.end());
+        std::vector<std::pair<int, std::string>> queue = { { rootId, root == "/" ? "" : root } };
+        bool complete = true;
+        while (!queue.empty())
+        {
+            if (m_cancel.cancelled())
+                return false;
+            int id = queue.back().first;
+            std::string dir = queue.back().second;
+            queue.pop_back();
+            folders.insert(id);
+            access->keepDirectory(id, true);
+            if (cached.count(id))
             {
-                return -EIO;
+                std::vector<DirectoryChange> changes;
+                if (access->refreshDirectory(id, changes))
+                    for (auto& c : changes)
+                        notifyChange(dir + "/" + c.entry.name, c);
+                else
+                    complete = false;
+            }
+            std::list<FileInfo> entries = access->getDirectoryContent(id);
+            if (!cached.count(id) && entries.empty() && !FJAccess::online())
+                complete = false;
+            std::list<FileInfo> small;
+            for (auto& e : entries)
+            {
+                if (e.isDir)
+                {
+                    queue.push_back({ e.id, dir + "/" + e.name });
+                    continue;
+                }
+                files.insert(e.id);
+                if (!g_cache || (g_cache->contains(e.id, contentVersion(e)) && g_cache->keep(e.id, true)))
+                    continue;
+                if (e.size <= ARCHIVE_MAX_FILE)
+                {
+                    small.push_back(e);
+                    continue;
+                }
+                std::string tmp = g_tempDir + "/fj_pin_" + std::to_string(e.id);
+                std::error_code ec;
+                if (!access->copyFile(e.id, tmp))
+                {
+                    fs::remove(tmp, ec);
+                    complete = false;
+                    continue;
+                }
+                if (!keep(e, tmp))
+                    complete = false;
             }
+            // small files of a folder come as one archive instead of a request each
+            if (!small.empty() && !access->downloadArchive(small, [&](const FileInfo& e, const std::string& data)
+                {
+                    std::string tmp = g_tempDir + "/fj_pin_" + std::to_string(e.id);
+                    std::ofstream ofs(tmp, std::ios::binary | std::ios::trunc);
+                    ofs.write(data.data(), data.size());
+                    ofs.close();
+                    if (!ofs || !keep(e, tmp))
+                    {
+                        std::error_code ec;
+                        fs::remove(tmp, ec);
+                        complete = false;
+                    }
+                    return !m_cancel.cancelled();
+                }))
+                complete = false;
         }
+        return complete;
     }
 
-    try { fs::remove(hi.localPath); }
-    catch (...) {}
-    return 0;
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!stopping)
+        {
+            uint64_t now = GetTickCount64();
+            auto next = pins.end();
+            uint64_t wait = m_interval;
+            for (auto it = pins.begin(); it != pins.end(); ++it)
+            {
+                uint64_t due = it->second.attempted ? it->second.attempted + m_interval : 0;
+                if (due <= now)
+                {
+                    next = it;
+                    break;
+                }
+                wait = std::min(wait, due - now);
+            }
+            if (next == pins.end())
+            {
+                m_wake.wait_for(lock, std::chrono::milliseconds(wait));
+                continue;
+            }
+            std::string root = next->first;
+            next->second.attempted = now;
+            next->second.syncing = true;
+            lock.unlock();
+            std::unordered_set<int> folders, files;
+            bool ok = FJAccess::online() && sync(root, folders, files);
+            if (verbose)
+                fprintf(stderr, "pin %s: %zu folders, %zu files%s\n", root.c_str(), folders.size(), files.size(), ok ? "" : ", incomplete");
+            lock.lock();
+            auto it = pins.find(root);
+            if (it == pins.end())
+            {
+                // unpinned meanwhile
+                release(folders, files);
+                continue;
+            }
+            Pin& pin = it->second;
+            pin.syncing = false;
+            pin.failed = !ok;
+            if (ok)
+            {
+                // what is gone from the folder goes back to normal eviction
+                std::unordered_set<int> goneFolders, goneFiles;
+                for (int id : pin.folders)
+                    if (!folders.count(id))
+                        goneFolders.insert(id);
+                for (int id : pin.files)
+                    if (!files.count(id))
+                        goneFiles.insert(id);
+                release(goneFolders, goneFiles);
+                pin.folders = std::move(folders);
+                pin.files = std::move(files);
+                GetSystemTimeAsFileTime(&pin.synced);
+            }
+            else
+            {
+                pin.folders.insert(folders.begin(), folders.end());
+                pin.files.insert(files.begin(), files.end());
+            }
+        }
+    }
+public:
+    PinnedFolders(const std::string& file, unsigned intervalSeconds)
+        : m_file(file), m_interval((intervalSeconds ? intervalSeconds : 1) * 1000ULL)
+    {
+        if (file.empty())
+            return;
+        std::ifstream in(file);
+        std::string line;
+        while (std::getline(in, line))
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start != std::string::npos && line[start] != '#')
+                pins[normalize(line)];
+        }
+    }
+    ~PinnedFolders()
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            stopping = true;
+        }
+        m_cancel.cancel();
+        m_wake.notify_all();
+        if (worker.joinable())
+            worker.join();
+    }
+    void start()
+    {
+        worker = std::thread([this] { run(); });
+    }
+    size_t count()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return pins.size();
+    }
+    // Pin a folder and synchronize it at once; the pin file is written back
+    bool pin(const std::string& path)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        std::string root = normalize(path);
+        if (!pins.count(root))
+        {
+            pins[root];
+            m_wake.notify_all();
+        }
+        return save();
+    }
+    // Returns false when path is not a pinned folder itself
+    bool unpin(const std::string& path)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto it = pins.find(normalize(path));
+        if (it == pins.end())
+            return false;
+        std::string root = it->first;
+        release(it->second.folders, it->second.files);
+        pins.erase(it);
+        // pins inside it lost what both kept: synchronize them again
+        for (auto& p : pins)
+            if (covers(root, p.first))
+                p.second.attempted = 0;
+        m_wake.notify_all();
+        return save();
+    }
+    Status status(const std::string& path)
+    {
+        Status s = { "", { 0, 0 }, false, false };
+        std::string p = normalize(path);
+        std::lock_guard<std::mutex> guard(m_mutex);
+        for (auto& pin : pins)
+        {
+            // the innermost pin decides
+            if (covers(pin.first, p) && pin.first.size() >= s.root.size())
+                s = { pin.first, pin.second.synced, pin.second.syncing, pin.second.failed };
+        }
+        return s;
+    }
+};
+
+static PinnedFolders* g_pins = nullptr;
+
+static const char* XATTR_PINNED = "user.filejump.pinned";
+static const char* XATTR_STATE = "user.filejump.state";
+static const char* XATTR_SYNCED = "user.filejump.synced";
+
+// Copy an attribute value the way getxattr and listxattr return it: size 0 asks for the length
+static int xattrValue(const std::string& v, char* value, size_t size)
+{
+    if (size == 0)
+        return (int)v.size();
+    if (size < v.size())
+        return -ERANGE;
+    memcpy(value, v.data(), v.size());
+    return (int)v.size();
+}
+
+// Pin status of a path: pinned is "yes" for a pinned folder, "inherited" inside one, "no" elsewhere;
+// state and synced (UTC time of the last complete synchronization) exist for pinned paths only
+static int fj_getxattr(const char* path, const char* name, char* value, size_t size)
+{
+    if (isVirtual(path) || !g_pins)
+        return -ENODATA;
+    PinnedFolders::Status s = g_pins->status(path);
+    std::string v;
+    if (strcmp(name, XATTR_PINNED) == 0)
+        v = s.root.empty() ? "no" : s.root == path ? "yes" : "inherited";
+    else if (s.root.empty())
+        return -ENODATA;
+    else if (strcmp(name, XATTR_STATE) == 0)
+        v = s.syncing ? "syncing" : s.failed ? "stale" : s.synced.dwLowDateTime || s.synced.dwHighDateTime ? "synced" : "pending";
+    else if (strcmp(name, XATTR_SYNCED) == 0)
+    {
+        SYSTEMTIME st;
+        if ((!s.synced.dwLowDateTime && !s.synced.dwHighDateTime) || !FileTimeToSystemTime(&s.synced, &st))
+            v = "never";
+        else
+        {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "%04u-%02u-%02uT%02u:%02u:%02uZ", st.wYear, st.wMonth, st.wDay, st.wHour, st.wMinute, st.wSecond);
+            v = buf;
+        }
+    }
+    else
+        return -ENODATA;
+    return xattrValue(v, value, size);
+}
+
+static int fj_listxattr(const char* path, char* list, size_t size)
+{
+    if (isVirtual(path) || !g_pins)
+        return 0;
+    std::string names = std::string(XATTR_PINNED) + '\0';
+    if (!g_pins->status(path).root.empty())
+        names += std::string(XATTR_STATE) + '\0' + XATTR_SYNCED + '\0';
+    return xattrValue(names, list, size);
+}
+
+// Setting user.filejump.pinned to yes (or 1) on a folder pins it, no (or 0) unpins it
+static int fj_setxattr(const char* path, const char* name, const char* value, size_t size, int flags)
+{
+    (void)flags;
+    if (isVirtual(path) || !g_pins)
+        return -EACCES;
+    if (strcmp(name, XATTR_PINNED) != 0)
+        return -ENOTSUP;
+    std::string v(value, size);
+    bool on = v == "yes" || v == "1" || v == "true";
+    if (!on && v != "no" && v != "0" && v != "false")
+        return -EINVAL;
+    if (!on)
+        return g_pins->unpin(path) ? 0 : -EINVAL;
+    if (strcmp(path, "/") != 0)
+    {
+        const struct FileInfo* entry = FJAccess::getInstance()->findFile(path);
+        if (!entry)
+            return -ENOENT;
+        bool isDir = entry->isDir;
+        delete entry;
+        if (!isDir)
+            return -ENOTDIR;
+    }
+    return g_pins->pin(path) ? 0 : -EIO;
+}
+
+static const size_t WARM_FOLDERS = 256;
+static const size_t WARM_FILES = 4096;
+
+// List the folders used most in earlier sessions, then download their most used files into the
+// content cache until g_warmBudget bytes were fetched; runs in the background after mounting
+static void warmFromHistory()
+{
+    CancellationToken::Scope scope(&g_historyCancel);
+    FJAccess* access = FJAccess::getInstance();
+    auto folders = g_history->hottest(WARM_FOLDERS, true);
+    {
+        TaskPool pool(4);
+        for (auto& f : folders)
+            pool.submit([access, path = f.path]
+                {
+                    CancellationToken::Scope scope(&g_historyCancel);
+                    int id = path == "/" ? 0 : access->lookupDirectoryID(path);
+                    if (id >= 0 && !g_historyCancel.cancelled())
+                        access->getDirectoryContent(id);
+                });
+        pool.wait();
+    }
+    if (verbose)
+        fprintf(stderr, "history: %zu folders listed\n", folders.size());
+    if (!g_cache || !g_warmBudget)
+        return;
+
+    // larger files are not admitted on their first read
+    uint64_t budget = g_warmBudget, largest = g_cache->stats().capacity / 8;
+    size_t fetched = 0;
+    for (auto& f : g_history->hottest(WARM_FILES, false))
+    {
+        if (g_historyCancel.cancelled())
+            return;
+        const struct FileInfo* entry = access->findFile(f.path);
+        if (!entry)
+            continue;
+        FileInfo e = *entry;
+        delete entry;
+        if (e.isDir || e.size > budget || e.size > largest || g_cache->contains(e.id, contentVersion(e)))
+            continue;
+        std::string tmp = g_tempDir + "/fj_warm_" + std::to_string(e.id);
+        std::error_code ec;
+        if (!access->copyFile(e.id, tmp))
+        {
+            fs::remove(tmp, ec);
+            continue;
+        }
+        bool cached = false;
+        std::string path = g_cache->admit(e.id, contentVersion(e), tmp, e.size, cached);
+        if (!cached)
+        {
+            fs::remove(path, ec);
+            continue;
+        }
+        g_cache->release(path);
+        budget -= e.size;
+        fetched++;
+    }
+    if (verbose)
+        fprintf(stderr, "history: %zu files, %llu bytes prefetched\n", fetched, (unsigned long long)(g_warmBudget - budget));
+}
+
+// Crawl the whole tree in the background: fills the directory cache and the name index. Started at
+// mount with --warmup and by the first search; a crawl that did not complete is started again by
+// a later search, but not more often than every WARMUP_RETRY_MS
+static void startWarmup()
+{
+    const uint64_t WARMUP_RETRY_MS = 60000;
+    std::lock_guard<std::mutex> guard(g_warmupMutex);
+    uint64_t now = GetTickCount64();
+    if (g_warmupClosed || g_warmupRunning || (g_warmupStarted && now - g_warmupStarted < WARMUP_RETRY_MS))
+        return;
+    if (g_warmupThread.joinable())
+        g_warmupThread.join();
+    if (!g_crawler)
+        g_crawler = new TreeCrawler(FJAccess::getInstance(), 8);
+    g_warmupStarted = now;
+    g_warmupRunning = true;
+    g_warmupThread = std::thread([]
+        {
+            bool complete = FJAccess::getInstance()->warmup(*g_crawler, [](const TreeCrawler::Progress& p)
+                {
+                    if (verbose)
+                        fprintf(stderr, "warmup: %llu folders, %llu entries, %llu pending, %u in flight\n",
+                            (unsigned long long)p.folders, (unsigned long long)p.entries,
+                            (unsigned long long)p.pending, p.inFlight);
+                });
+            if (verbose)
+                fprintf(stderr, "warmup %s\n", complete ? "finished" : "stopped");
+            g_warmupRunning = false;
+        });
+}
+
+static void* fj_init(struct fuse_conn_info* conn, struct fuse_config* cfg)
+{
+    (void)conn;
+    (void)cfg;
+    g_fuse = fuse_get_context()->fuse;
+    if (g_watchInterval)
+    {
+        g_watcher = new ChangeWatcher(FJAccess::getInstance(), g_watchInterval, notifyChange);
+        g_watcher->start();
+    }
+    if (g_warmup)
+        startWarmup();
+    if (g_history && g_history->size())
+        g_historyThread = std::thread(warmFromHistory);
+    if (g_pins)
+        g_pins->start();
+    return NULL;
+}
+
+static void fj_destroy(void* private_data)
+{
+    (void)private_data;
+    g_historyCancel.cancel();
+    if (g_historyThread.joinable())
+        g_historyThread.join();
+    delete g_pins;
+    g_pins = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(g_warmupMutex);
+        g_warmupClosed = true;
+        if (g_crawler)
+            g_crawler->cancel();
+        if (g_warmupThread.joinable())
+            g_warmupThread.join();
+        delete g_crawler;
+        g_crawler = nullptr;
+    }
+    delete g_watcher;
+    g_watcher = nullptr;
+    // queued head reads return at once
+    g_stopping = true;
+    delete g_headPool;
+    g_headPool = nullptr;
+    // temporary files that were never renamed are uploaded under their own name
+    for (auto& f : g_local.drain())
+    {
+        if (g_writeBack)
+            g_writeBack->submit(f.first, f.second);
+        else if (!uploadAs(f.first, f.second, nullptr))
+            fprintf(stderr, "upload of %s failed\n", f.first.c_str());
+    }
+    // uploads everything still waiting
+    delete g_writeBack;
+    g_writeBack = nullptr;
+    g_fuse = nullptr;
 }
 
 static struct fuse_operations fj_oper = {};
@@ -414,6 +2343,13 @@ int main(int argc, char* argv[])
     // read env config
     std::wstring baseUrl, auth;
     std::string user, password;
+    std::string indexFile;
+    std::string historyFile;
+    std::string pinsFile;
+    unsigned pinRefresh = 300;
+    uint64_t cacheSize = 0;
+    size_t headSize = 0;
+    unsigned debounce = 0;
     char const* baseUrlEnv = std::getenv("FILEJUMP_BASE_URL");
     char const* authEnv = std::getenv("FILEJUMP_AUTH_TOKEN");
     int fuse_argc = 0;
@@ -438,6 +2374,83 @@ int main(int argc, char* argv[])
             verbose = true;
             FJAccess::set_verbose(verbose);
         }
+        else if (std::string(argv[arg]) == "--compress")
+        {
+            FJAccess::set_compression(true);
+        }
+        else if (std::string(argv[arg]) == "--dedup")
+        {
+            FJAccess::set_dedup(std::strtoull(argv[arg + 1], nullptr, 10) * 1024 * 1024);
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--hedge")
+        {
+            FJAccess::set_hedging(true);
+        }
+        else if (std::string(argv[arg]) == "--breaker")
+        {
+            FJAccess::set_circuit_breaker((unsigned)std::strtoul(argv[arg + 1], nullptr, 10));
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--timeout")
+        {
+            g_opTimeoutMs = (unsigned)std::strtoul(argv[arg + 1], nullptr, 10) * 1000;
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--warmup")
+        {
+            g_warmup = true;
+        }
+        else if (std::string(argv[arg]) == "--watch")
+        {
+            g_watchInterval = (unsigned)std::strtoul(argv[arg + 1], nullptr, 10);
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--cache")
+        {
+            cacheSize = std::strtoull(argv[arg + 1], nullptr, 10) * 1024 * 1024;
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--heads")
+        {
+            headSize = (size_t)std::strtoul(argv[arg + 1], nullptr, 10) * 1024;
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--debounce")
+        {
+            debounce = (unsigned)std::strtoul(argv[arg + 1], nullptr, 10);
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--local")
+        {
+            g_local.addPattern(argv[arg + 1]);
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--history")
+        {
+            historyFile = argv[arg + 1];
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--warm")
+        {
+            g_warmBudget = std::strtoull(argv[arg + 1], nullptr, 10) * 1024 * 1024;
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--pins")
+        {
+            pinsFile = argv[arg + 1];
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--pin-refresh")
+        {
+            pinRefresh = (unsigned)std::strtoul(argv[arg + 1], nullptr, 10);
+            arg++;
+        }
+        else if (std::string(argv[arg]) == "--index")
+        {
+            indexFile = argv[arg + 1];
+            arg++;
+        }
         else if (std::string(argv[arg]) == "--server")
         {
             baseUrl = CUrlTools::Utf8ToWide(argv[arg + 1]);
@@ -471,6 +2484,22 @@ int main(int argc, char* argv[])
         usage += "\t--user-email and --password to authenticate with user name and password (instead of token);\n";
         usage += "It is also possible to authenticate with environment variables FILEJUMP_BASE_URL and FILEJUMP_AUTH_TOKEN - just set variables instead of command line;\n";
         usage += "--verbose to get more information for debugging\n";
+        usage += "--compress to compress text-like files while uploading (reads are decompressed transparently)\n";
+        usage += "--dedup <MB> to store files of at least MB megabytes as deduplicated chunks (reads are reassembled transparently)\n";
+        usage += "--hedge to send slow listing and read requests a second time and use the first answer\n";
+        usage += "--breaker <failures> to stop sending requests for a while after the given number of failed ones in a row and work from the local caches (default 5, 0 = off)\n";
+        usage += "--timeout <seconds> to fail an operation on the drive when FileJump does not answer within the given number of seconds\n";
+        usage += "--warmup to read the whole folder tree in the background after mounting\n";
+        usage += "--watch <seconds> to check the cached folders for remote changes every given number of seconds\n";
+        usage += "--cache <MB> to keep up to MB megabytes of read file content on the local disk\n";
+        usage += "--heads <KB> to keep the first KB kilobytes of files for type detection and thumbnails\n";
+        usage += "--debounce <seconds> to upload saved files only after they were not saved again for the given number of seconds\n";
+        usage += "--local <pattern> to keep files whose name matches pattern (like *.bak) on the local disk only; can be repeated\n";
+        usage += "--history <file> to record which folders and files are used, in file; at the next mount they are read again in the background\n";
+        usage += "--warm <MB> to download up to MB megabytes of the most used files into the content cache after mounting (with --history and --cache)\n";
+        usage += "--pins <file> to keep the folders listed in file (one path per line) available offline and refresh them in the background\n";
+        usage += "--pin-refresh <seconds> to refresh pinned folders every given number of seconds (default 300)\n";
+        usage += "--index <file> to load the search index from file at mount and save it there at unmount\n";
         fprintf(stderr, usage.c_str());
         exit(-1);
     }
@@ -488,6 +2517,21 @@ int main(int argc, char* argv[])
         g_tempDir = std::string(tmpPath) + "filejumpfs";
     }
     fs::create_directories(g_tempDir);
+    g_local.setDir(g_tempDir + "/local");
+    // pinned content is kept outside the capacity, so pins work without --cache too
+    if (cacheSize || !pinsFile.empty())
+        g_cache = new ContentCache(g_tempDir + "/cache", cacheSize);
+    g_pins = new PinnedFolders(pinsFile, pinRefresh);
+    // without --debounce the queue only holds saves made while the server is not available
+    g_writeBack = new WriteBack(g_tempDir + "/queue", debounce, [](const std::string& path, const std::string& local, const CancellationToken& cancel)
+        {
+            return uploadAs(path, local, &cancel);
+        }, FJAccess::online);
+    if (headSize)
+    {
+        g_heads = new HeadCache(headSize, 256ULL * 1024 * 1024);
+        g_headPool = new TaskPool(4);
+    }
 
     fj_oper.getattr = fj_getattr;
     fj_oper.readdir = fj_readdir;
@@ -499,8 +2543,35 @@ int main(int argc, char* argv[])
     fj_oper.mkdir = fj_mkdir;
     fj_oper.rmdir = fj_rmdir;
     fj_oper.release = fj_release;
+    fj_oper.fsync = fj_fsync;
+    fj_oper.rename = fj_rename;
+    fj_oper.init = fj_init;
+    fj_oper.destroy = fj_destroy;
+    fj_oper.getxattr = fj_getxattr;
+    fj_oper.setxattr = fj_setxattr;
+    fj_oper.listxattr = fj_listxattr;
+
+    if (!indexFile.empty() && FJAccess::getInstance()->loadIndex(indexFile) && verbose)
+        fprintf(stderr, "Search index loaded from %s\n", indexFile.c_str());
+    if (!indexFile.empty() && g_heads && g_heads->load(indexFile + ".heads") && verbose)
+        fprintf(stderr, "File heads loaded from %s.heads\n", indexFile.c_str());
+    if (!historyFile.empty())
+    {
+        g_history = new AccessHistory();
+        if (g_history->load(historyFile) && verbose)
+            fprintf(stderr, "Access history loaded from %s, %zu paths\n", historyFile.c_str(), g_history->size());
+    }
 
     int result = fuse_main(fuse_argc, fuse_argv, &fj_oper, NULL);
+    if (!indexFile.empty())
+        FJAccess::getInstance()->saveIndex(indexFile);
+    if (!indexFile.empty() && g_heads)
+        g_heads->save(indexFile + ".heads");
+    if (g_history && !g_history->save(historyFile))
+        fprintf(stderr, "Access history could not be saved to %s\n", historyFile.c_str());
+    delete g_history;
+    delete g_heads;
+    delete g_cache;
     delete[] fuse_argv;
     return result;
 }
@@ -0,0 +1,136 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#include "FJAccess.h"
+#include "CUrlTools.h"
+#include "SyncEngine.h"
+
+static const char* actionName(SyncEngine::Action action)
+{
+    switch (action)
+    {
+    case SyncEngine::Action::CreateFolder: return "mkdir  ";
+    case SyncEngine::Action::Upload:       return "upload ";
+    case SyncEngine::Action::Replace:      return "replace";
+    case SyncEngine::Action::Delete:       return "delete ";
+    case SyncEngine::Action::Skip:         return "same   ";
+    default:                               return "FAILED ";
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    // read env config
+    std::wstring baseUrl, auth;
+    std::string user, password;
+    std::string localDir, remotePath;
+    bool verbose = false;
+    SyncOptions options;
+    char const* baseUrlEnv = std::getenv("FILEJUMP_BASE_URL");
+    char const* authEnv = std::getenv("FILEJUMP_AUTH_TOKEN");
+
+    if (baseUrlEnv)
+        baseUrl = CUrlTools::Utf8ToWide(baseUrlEnv);
+    if (authEnv)
+        auth = CUrlTools::Utf8ToWide(authEnv);
+
+    for (int arg = 1; arg < argc; arg++)
+    {
+        std::string a = argv[arg];
+        bool hasValue = arg + 1 < argc;
+        if (a == "--verbose")
+        {
+            verbose = true;
+            FJAccess::set_verbose(verbose);
+        }
+        else if (a == "--server" && hasValue)
+            baseUrl = CUrlTools::Utf8ToWide(argv[++arg]);
+        else if (a == "--token" && hasValue)
+            auth = CUrlTools::Utf8ToWide(argv[++arg]);
+        else if (a == "--user-email" && hasValue)
+            user = argv[++arg];
+        else if (a == "--password" && hasValue)
+            password = argv[++arg];
+        else if (a == "--threads" && hasValue)
+            options.threads = (unsigned)std::strtoul(argv[++arg], nullptr, 10);
+        else if (a == "--delete")
+            options.deleteExtra = true;
+        else if (a == "--hash")
+            options.compareHash = true;
+        else if (a == "--dry-run")
+            options.dryRun = true;
+        else if (localDir.empty())
+            localDir = a;
+        else if (remotePath.empty())
+            remotePath = a;
+    }
+    if (baseUrl.empty() || (auth.empty() && password.empty()) || localDir.empty() || remotePath.empty())
+    {
+        std::string usage;
+        usage =  "FileJumpSync uploads a local folder to a FileJump folder, transferring only new and changed files.\n";
+        usage += "usage: FileJumpSync [parameters] <local folder> <remote folder>, e.g. FileJumpSync C:\\Photos /backup/photos\n";
+        usage += "parameters are:\n\t--server: URL of server to use;\n\t--token: security token to access to FileJump media;\n";
+        usage += "\t--user-email and --password to authenticate with user name and password (instead of token);\n";
+        usage += "It is also possible to authenticate with environment variables FILEJUMP_BASE_URL and FILEJUMP_AUTH_TOKEN - just set variables instead of command line;\n";
+        usage += "--threads <N> number of parallel uploads (default 4)\n";
+        usage += "--delete to delete remote files and folders that do not exist locally\n";
+        usage += "--hash to compare SHA-256 of files whose size matches but modification time does not\n";
+        usage += "--dry-run to print what would be done without changing anything\n";
+        usage += "--verbose to get more information for debugging\n";
+        fprintf(stderr, usage.c_str());
+        return -1;
+    }
+    if (!user.empty() && !password.empty())
+    {
+        if (!FJAccess::configure_with_password(baseUrl, user, password))
+        {
+            fprintf(stderr, "Login failed\n");
+            return -1;
+        }
+    }
+    else
+        FJAccess::configure(baseUrl, auth);
+
+    SyncEngine engine(FJAccess::getInstance());
+    SyncStats stats;
+    bool ok = engine.sync(localDir, remotePath, options, stats,
+        [verbose](SyncEngine::Action action, const std::string& path)
+        {
+            if (action != SyncEngine::Action::Skip || verbose)
+                printf("%s %s\n", actionName(action), path.c_str());
+        });
+    if (!ok && stats.failed == 0)
+        fprintf(stderr, "Cannot access %s or %s\n", localDir.c_str(), remotePath.c_str());
+    printf("%llu files scanned, %llu uploaded (%llu bytes), %llu unchanged, %llu folders created, %llu deleted, %llu failed\n",
+        stats.scanned, stats.uploaded, stats.bytes, stats.skipped, stats.folders, stats.deleted, stats.failed);
+    FJAccess::destroy();
+    return ok ? 0 : 1;
+}
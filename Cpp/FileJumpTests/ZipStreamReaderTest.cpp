@@ -0,0 +1,289 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+
+// Checks ZipStreamReader against archives built in memory, fed in small chunks the way
+// HttpGetStream delivers them. Prints the failed checks and returns 1 when one failed.
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <algorithm>
+
+#include "ZipStreamReader.h"
+
+static int failures = 0;
+
+#define CHECK(cond) \
+    do { if (!(cond)) { fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond); failures++; } } while (0)
+
+static void put16(std::string& out, uint16_t v)
+{
+    out += (char)(v & 0xff);
+    out += (char)(v >> 8);
+}
+
+static void put32(std::string& out, uint32_t v)
+{
+    put16(out, (uint16_t)(v & 0xffff));
+    put16(out, (uint16_t)(v >> 16));
+}
+
+// Raw deflate stream made of stored blocks, which every inflater must accept
+static std::string deflateStored(const std::string& data)
+{
+    std::string out;
+    size_t pos = 0;
+    do
+    {
+        size_t len = std::min<size_t>(data.size() - pos, 0xffff);
+        out += (char)(pos + len == data.size() ? 1 : 0);     // BFINAL, BTYPE 00
+        put16(out, (uint16_t)len);
+        put16(out, (uint16_t)~len);
+        out.append(data, pos, len);
+        pos += len;
+    } while (pos < data.size());
+    return out;
+}
+
+struct Entry
+{
+    std::string name;
+    std::string data;
+    bool deflate;
+    bool descriptor;            // sizes follow the data
+    bool signature;             // the data descriptor starts with its signature
+    std::string compressed;     // deflate stream to store instead of the stored-block one
+};
+
+static std::string buildArchive(const std::vector<Entry>& entries, bool centralDirectory)
+{
+    std::string out;
+    for (auto& e : entries)
+    {
+        std::string stored = !e.compressed.empty() ? e.compressed : (e.deflate ? deflateStored(e.data) : e.data);
+        uint32_t crc = ZipStreamReader::crc32(e.data.data(), e.data.size());
+        put32(out, 0x04034b50);
+        put16(out, 20);
+        put16(out, e.descriptor ? 0x0008 : 0);
+        put16(out, e.deflate ? 8 : 0);
+        put32(out, 0);                                      // time and date
+        put32(out, e.descriptor ? 0 : crc);
+        put32(out, e.descriptor ? 0 : (uint32_t)stored.size());
+        put32(out, e.descriptor ? 0 : (uint32_t)e.data.size());
+        put16(out, (uint16_t)e.name.size());
+        put16(out, 0);
+        out += e.name;
+        out += stored;
+        if (e.descriptor)
+        {
+            if (e.signature)
+                put32(out, 0x08074b50);
+            put32(out, crc);
+            put32(out, (uint32_t)stored.size());
+            put32(out, (uint32_t)e.data.size());
+        }
+    }
+    if (centralDirectory)
+    {
+        // the reader stops at the first central directory record, its content is not needed
+        put32(out, 0x06054b50);
+        out.append(18, '\0');
+    }
+    return out;
+}
+
+static std::string pattern(size_t size, unsigned seed)
+{
+    std::string out(size, '\0');
+    for (size_t i = 0; i < size; i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        out[i] = (char)(seed >> 16);
+    }
+    return out;
+}
+
+// Feeds the archive in chunks and returns the entries delivered, with the results of the calls
+static std::vector<Entry> readArchive(const std::string& archive, size_t chunk, bool& fed, bool& finished)
+{
+    std::vector<Entry> read;
+    ZipStreamReader reader([&](const std::string& name, const std::string& data)
+        {
+            read.push_back({ name, data, false, false, false });
+            return true;
+        });
+    fed = true;
+    for (size_t pos = 0; fed && pos < archive.size(); pos += chunk)
+        fed = reader.feed(archive.data() + pos, std::min(chunk, archive.size() - pos));
+    fed = fed && reader.finish();
+    finished = reader.finished();
+    return read;
+}
+
+static void testLastEntryWithDescriptor(bool deflate, bool signature, bool centralDirectory)
+{
+    std::vector<Entry> entries = {
+        { "small.txt", "hello, world", deflate, true, signature },
+        { "dir/large.bin", pattern(300000, 7), deflate, true, signature } };
+    bool fed = false, finished = false;
+    std::vector<Entry> read = readArchive(buildArchive(entries, centralDirectory), 4096, fed, finished);
+    CHECK(fed);
+    CHECK(finished == centralDirectory);
+    CHECK(read.size() == 2);
+    for (size_t i = 0; i < read.size() && i < entries.size(); i++)
+    {
+        CHECK(read[i].name == entries[i].name);
+        CHECK(read[i].data == entries[i].data);
+    }
+}
+
+static void testSingleEntry()
+{
+    // a single deflated entry of 300000 bytes with a data descriptor, as the server streams it
+    std::vector<Entry> entries = { { "only.bin", pattern(300000, 3), true, true, true } };
+    std::string archive = buildArchive(entries, true);
+    for (size_t chunk : { (size_t)1000, (size_t)16384, archive.size() })
+    {
+        bool fed = false, finished = false;
+        std::vector<Entry> read = readArchive(archive, chunk, fed, finished);
+        CHECK(fed && finished);
+        CHECK(read.size() == 1 && read[0].data == entries[0].data);
+    }
+}
+
+static void testKnownSizes()
+{
+    std::vector<Entry> entries = {
+        { "a", pattern(70000, 1), false, false, false },
+        { "b", pattern(70000, 2), true, false, false },
+        { "folder/", "", false, false, false } };
+    bool fed = false, finished = false;
+    std::vector<Entry> read = readArchive(buildArchive(entries, true), 512, fed, finished);
+    CHECK(fed && finished);
+    CHECK(read.size() == 2);    // folder entries are not delivered
+}
+
+static void testCorruptCrc()
+{
+    std::vector<Entry> entries = { { "x", pattern(1000, 5), true, true, true } };
+    std::string archive = buildArchive(entries, true);
+    archive[archive.size() - 22 - 12] ^= 1;                  // CRC in the data descriptor
+    bool fed = true, finished = false;
+    readArchive(archive, 100, fed, finished);
+    CHECK(!fed);
+}
+
+// Raw deflate streams written by zlib (compressobj(level, DEFLATED, -15)): the short text is coded with
+// the fixed Huffman codes, the long one with dynamic codes, at levels 1 and 9
+static const char shortText[] = "hello, hello, hello deflate";
+static const uint32_t shortTextCrc = 0x49972860;
+static const uint32_t longTextCrc = 0x187b5864;
+
+static const unsigned char fixedLevel1[] = {
+    0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0xc8, 0x40, 0xa2, 0x14, 0x52, 0x52, 0xd3, 0x72, 0x12,
+    0x4b, 0x52, 0x01 };
+
+static const unsigned char fixedLevel9[] = {
+    0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0xc8, 0x40, 0xa2, 0x14, 0x52, 0x52, 0xd3, 0x72, 0x12,
+    0x4b, 0x52, 0x01 };
+
+static const unsigned char dynamicLevel1[] = {
+    0x9d, 0xd2, 0x49, 0x16, 0xc1, 0x60, 0x14, 0x05, 0xe1, 0xb9, 0x55, 0xbc, 0x25, 0x78, 0xf7, 0xea,
+    0x77, 0xa3, 0x09, 0x42, 0xe4, 0x27, 0x44, 0xb7, 0x7a, 0x87, 0x1d, 0xa8, 0x71, 0x9d, 0x9a, 0x7d,
+    0x4d, 0xdd, 0x56, 0x31, 0x5c, 0xc4, 0x6d, 0x5f, 0xc5, 0xa5, 0xaf, 0xd7, 0xc7, 0x58, 0x75, 0xe5,
+    0xd1, 0xc6, 0xb6, 0x3c, 0xe3, 0xd0, 0x9f, 0xce, 0xd7, 0x28, 0xf7, 0xaa, 0xfb, 0xe5, 0x66, 0xf9,
+    0x7e, 0xc5, 0xa6, 0xec, 0x06, 0xcd, 0xf7, 0x49, 0xf0, 0x08, 0x3c, 0x06, 0xcf, 0x08, 0x3c, 0x63,
+    0xf0, 0x4c, 0xc0, 0x33, 0x05, 0xcf, 0x0c, 0x3c, 0x73, 0xf0, 0x24, 0x82, 0x40, 0x24, 0x24, 0xa1,
+    0x90, 0xc4, 0x42, 0x12, 0x0c, 0x49, 0x34, 0x24, 0xe1, 0x90, 0xc4, 0x43, 0x12, 0x10, 0x49, 0x44,
+    0x88, 0x88, 0x10, 0x11, 0x21, 0x22, 0x42, 0x44, 0x84, 0x88, 0x08, 0x11, 0x11, 0x22, 0x22, 0x44,
+    0x44, 0x88, 0x88, 0x10, 0x11, 0x61, 0x22, 0xc2, 0x44, 0x84, 0x89, 0x08, 0x13, 0x11, 0x26, 0x22,
+    0x4c, 0x44, 0x98, 0x88, 0x30, 0x11, 0x61, 0x22, 0xc2, 0x7f, 0x8a, 0xf8, 0x00 };
+
+static const unsigned char dynamicLevel9[] = {
+    0x9d, 0xd5, 0x5b, 0x16, 0xc1, 0x50, 0x0c, 0x46, 0xe1, 0x77, 0xa3, 0xc8, 0x10, 0xe4, 0x0f, 0x2d,
+    0x66, 0xe3, 0x72, 0x68, 0x39, 0x7a, 0x68, 0xd5, 0x6d, 0xf4, 0x16, 0x33, 0xb0, 0x9f, 0xb3, 0xf6,
+    0x53, 0xbe, 0x95, 0xe4, 0xb6, 0x4b, 0x36, 0x5d, 0xd9, 0xad, 0x49, 0x76, 0x1d, 0xdb, 0xed, 0xc9,
+    0x36, 0x7d, 0x79, 0x74, 0xb6, 0x2f, 0x4f, 0x3b, 0x8e, 0xe7, 0xcb, 0x60, 0xe5, 0x9e, 0xfa, 0xdf,
+    0x38, 0xaf, 0xdf, 0x2f, 0xdb, 0x95, 0xc3, 0x24, 0x7f, 0x1b, 0x07, 0x8d, 0x40, 0x13, 0xa0, 0x99,
+    0x81, 0x66, 0x0e, 0x9a, 0x0a, 0x34, 0x35, 0x68, 0x16, 0xa0, 0x59, 0x92, 0x9d, 0x22, 0x08, 0x44,
+    0x82, 0x13, 0x0a, 0x4e, 0x2c, 0x38, 0xc1, 0xe0, 0x44, 0x83, 0x13, 0x0e, 0x4e, 0x3c, 0x38, 0x01,
+    0xe1, 0x44, 0x84, 0x88, 0x08, 0xa1, 0xdb, 0x40, 0x44, 0x88, 0x88, 0x10, 0x11, 0x21, 0x22, 0x42,
+    0x44, 0x84, 0x88, 0x08, 0x11, 0x11, 0x22, 0x22, 0x82, 0x88, 0x08, 0x22, 0x22, 0xd0, 0xbb, 0x20,
+    0x22, 0x82, 0x88, 0x08, 0x22, 0x22, 0x88, 0x88, 0x20, 0x22, 0x82, 0x88, 0x88, 0x3f, 0x45, 0x7c,
+    0x00 };
+
+static std::string longText()
+{
+    std::string out;
+    for (int i = 0; i < 40; i++)
+        out += "line " + std::to_string(i) + ": the quick brown fox jumps over the lazy dog\n";
+    return out;
+}
+
+static void testZlibStream(const unsigned char* stream, size_t size, int blockType, const std::string& text, uint32_t crc)
+{
+    std::string compressed((const char*)stream, size);
+    CHECK(((stream[0] >> 1) & 3) == blockType);
+    CHECK(ZipStreamReader::crc32(text.data(), text.size()) == crc);
+    std::string out;
+    size_t consumed = 0;
+    CHECK(ZipStreamReader::inflate(compressed.data(), compressed.size(), out, consumed) == 0);
+    CHECK(consumed == size);
+    CHECK(out == text);
+    CHECK(ZipStreamReader::crc32(out.data(), out.size()) == crc);
+    // a stream cut short asks for more input
+    out.clear();
+    CHECK(ZipStreamReader::inflate(compressed.data(), compressed.size() - 1, out, consumed) == 1);
+    // the same stream in an archive, with the CRC and sizes in a data descriptor
+    std::vector<Entry> entries = { { "zlib.txt", text, true, true, true, compressed } };
+    bool fed = false, finished = false;
+    std::vector<Entry> read = readArchive(buildArchive(entries, true), 7, fed, finished);
+    CHECK(fed && finished);
+    CHECK(read.size() == 1 && read[0].data == text);
+}
+
+int main()
+{
+    for (bool deflate : { true, false })
+        for (bool centralDirectory : { true, false })
+            testLastEntryWithDescriptor(deflate, true, centralDirectory);
+    // without a signature only deflated entries can be delimited
+    testLastEntryWithDescriptor(true, false, true);
+    testLastEntryWithDescriptor(true, false, false);
+    testSingleEntry();
+    testKnownSizes();
+    testCorruptCrc();
+    testZlibStream(fixedLevel1, sizeof(fixedLevel1), 1, shortText, shortTextCrc);
+    testZlibStream(fixedLevel9, sizeof(fixedLevel9), 1, shortText, shortTextCrc);
+    testZlibStream(dynamicLevel1, sizeof(dynamicLevel1), 2, longText(), longTextCrc);
+    testZlibStream(dynamicLevel9, sizeof(dynamicLevel9), 2, longText(), longTextCrc);
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    else
+        printf("ZipStreamReader: all checks passed\n");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <climits>
+#include <cstdint>
+#include "FileJump.h"
+
+/**
+
+    @class   CancellationToken
+    @brief   Class lets one thread abandon the requests another thread is waiting for;
+    @details A token is cancelled explicitly, or implicitly when its deadline passes. The transport
+             gives every request the time left until the deadline as its WinInet timeouts and closes
+             the request handle from cancel(), so an abandoned request frees its connection at once.
+             FJAccess calls pick up the token installed on their thread with Scope; requests sent
+             from other threads (crawler, chunk workers) are not covered.
+
+**/
+class FILEJUMP_API CancellationToken
+{
+private:
+	std::atomic<bool> m_cancelled{ false };
+	std::chrono::steady_clock::time_point m_deadline = std::chrono::steady_clock::time_point::max();
+	std::mutex m_mutex;
+	std::map<size_t, std::function<void()>> callbacks;
+	size_t nextId = 0;
+
+	// Defined in the library, so the exe and the DLL share the thread's token
+	static CancellationToken*& slot();
+public:
+	CancellationToken() = default;
+	// Token that is cancelled timeoutMs from now; 0 = no deadline
+	explicit CancellationToken(unsigned timeoutMs)
+	{
+		if (timeoutMs)
+			m_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+	}
+	CancellationToken(const CancellationToken&) = delete;
+	CancellationToken& operator=(const CancellationToken&) = delete;
+
+	// Run the callbacks of the requests in progress; later requests fail at once
+	void cancel()
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (m_cancelled.exchange(true))
+			return;
+		for (auto& c : callbacks)
+			c.second();
+	}
+	bool cancelled() const
+	{
+		return m_cancelled || std::chrono::steady_clock::now() >= m_deadline;
+	}
+	// Milliseconds left until the deadline, UINT_MAX without one, 0 when cancelled
+	unsigned remainingMs() const
+	{
+		if (m_cancelled)
+			return 0;
+		if (m_deadline == std::chrono::steady_clock::time_point::max())
+			return UINT_MAX;
+		auto left = std::chrono::duration_cast<std::chrono::milliseconds>(m_deadline - std::chrono::steady_clock::now()).count();
+		return left > 0 ? (unsigned)left : 0;
+	}
+	/**
+	 * @brief Call onCancel from cancel() until unsubscribed; runs it at once when already cancelled
+	 * @details onCancel runs under the token's lock, so it is not running anymore once unsubscribe returns.
+	 */
+	size_t subscribe(std::function<void()> onCancel)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (m_cancelled)
+		{
+			onCancel();
+			return SIZE_MAX;
+		}
+		callbacks[nextId] = std::move(onCancel);
+		return nextId++;
+	}
+	void unsubscribe(size_t id)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		callbacks.erase(id);
+	}
+
+	// Token installed on the calling thread, or nullptr
+	static CancellationToken* current()
+	{
+		return slot();
+	}
+
+	/**
+	    @class   Scope
+	    @brief   Class installs a token on the calling thread for its lifetime; nullptr clears the thread's token;
+	**/
+	class Scope
+	{
+	private:
+		CancellationToken* previous;
+	public:
+		explicit Scope(CancellationToken* token) : previous(slot())
+		{
+			slot() = token;
+		}
+		~Scope()
+		{
+			slot() = previous;
+		}
+		Scope(const Scope&) = delete;
+		Scope& operator=(const Scope&) = delete;
+	};
+};
@@ -0,0 +1,97 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include "FJAccess.h"
+
+/**
+
+    @class   ChangeWatcher
+    @brief   Class lists the cached directories again at a fixed interval and reports remote changes;
+    @details Changes are applied to the FJAccess caches before they are reported, so a callback that
+             invalidates a kernel cache sees the new state on the next lookup.
+
+**/
+class ChangeWatcher
+{
+public:
+	using Notify = std::function<void(const std::string& path, const DirectoryChange& change)>;
+private:
+	FJAccess* m_access;
+	std::chrono::seconds interval;
+	Notify notify;
+	std::thread worker;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool stopping = false;
+
+	void run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_wake.wait_for(lock, interval, [this] { return stopping; }))
+		{
+			lock.unlock();
+			for (int id : m_access->cachedDirectories())
+			{
+				std::string path = m_access->getDirectoryPath(id);
+				std::vector<DirectoryChange> changes;
+				if (path.empty() || !m_access->refreshDirectory(id, changes))
+					continue;
+				for (auto& c : changes)
+					notify(path + c.entry.name, c);
+			}
+			lock.lock();
+		}
+	}
+public:
+	ChangeWatcher(FJAccess* access, unsigned intervalSeconds, Notify onChange)
+		: m_access(access), interval(intervalSeconds ? intervalSeconds : 1), notify(std::move(onChange))
+	{
+	}
+	~ChangeWatcher()
+	{
+		stop();
+	}
+	void start()
+	{
+		if (!worker.joinable())
+			worker = std::thread([this] { run(); });
+	}
+	void stop()
+	{
+		{
+			std::lock_guard<std::mutex> guard(m_mutex);
+			stopping = true;
+		}
+		m_wake.notify_all();
+		if (worker.joinable())
+			worker.join();
+	}
+};
@@ -0,0 +1,137 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+#include "FileJump.h"
+
+class FJAccess;
+struct FileInfo;
+
+/**
+ * @brief Content-defined chunking layer that stores large files as deduplicated chunks
+ *
+ * A file is cut into chunks with FastCDC (gear rolling hash with normalized chunking),
+ * so an insertion or deletion only changes the chunks around it. Every chunk is stored
+ * once, as a FileJump file named by its SHA-256 under the hidden folder
+ * "/.fjchunks/<first two hex digits>/". The user-visible file holds a JSON manifest
+ * (hash, size and FileJump id of every chunk) and is marked in its description,
+ * so FJAccess::readFile reassembles the content through range reads of the chunks.
+ *
+ * Uploading a new version of a large file that differs by a few percent uploads only
+ * the changed chunks plus a new manifest. Chunks are not garbage-collected when the
+ * last manifest referencing them is deleted.
+ */
+class FILEJUMP_API ChunkStore
+{
+public:
+    static const uint32_t MIN_CHUNK = 256 * 1024;
+    static const uint32_t AVG_CHUNK = 1024 * 1024;
+    static const uint32_t MAX_CHUNK = 4 * 1024 * 1024;
+
+    struct Chunk
+    {
+        std::string hash;   // SHA-256, lowercase hex
+        uint64_t size;
+        int id;             // FileJump id of the chunk file
+    };
+    struct Manifest
+    {
+        uint64_t size = 0;
+        std::vector<Chunk> chunks;
+        std::vector<uint64_t> offsets;  // offset of each chunk in the file
+    };
+
+    explicit ChunkStore(FJAccess* access);
+
+    /**
+     * @brief Upload a file as chunks plus a manifest
+     * @param source Local path of the file
+     * @param parentId FileJump id of the folder the file is created in
+     * @param name Name of the file in FileJump
+     * @param uploaded Receives the entry of the created manifest file, may be nullptr
+     * @return true on success
+     */
+    bool upload(const std::string& source, int parentId, const std::string& name, FileInfo* uploaded);
+
+    /**
+     * @brief Read a byte range of a chunked file
+     * @param id FileJump id of the manifest file
+     * @param offset First byte to read
+     * @param length Number of bytes to read, 0 = up to the end of file
+     * @param out Receives the data
+     * @return true on success
+     */
+    bool read(int id, uint64_t offset, uint64_t length, std::string& out);
+
+    /**
+     * @brief Register a file that holds a manifest, as told by its description marker
+     */
+    void add(int id);
+
+    /**
+     * @brief Check whether a file holds a manifest
+     */
+    bool contains(int id);
+
+    /**
+     * @brief Find the length of the next chunk with FastCDC
+     * @param data Data starting at the chunk
+     * @param size Number of bytes available; when less than MAX_CHUNK the data must end the file
+     * @return Length of the chunk
+     */
+    static size_t cut(const unsigned char* data, size_t size);
+
+    /**
+     * @brief Calculate SHA-256 of a buffer
+     * @param data Buffer
+     * @param size Number of bytes
+     * @return Lowercase hex digest, empty string on failure
+     */
+    static std::string sha256(const char* data, size_t size);
+
+private:
+    FJAccess* m_access;
+    std::mutex m_mutex;                                 // guards m_files and m_manifests
+    std::unordered_set<int> m_files;                    // ids of files that hold a manifest
+    std::unordered_map<int, std::shared_ptr<const Manifest>> m_manifests;
+
+    std::mutex m_uploadMutex;                           // guards the members below
+    int m_rootId;                                       // id of "/.fjchunks", -1 until resolved
+    std::unordered_map<std::string, int> m_shards;      // "ab" -> folder id
+    std::unordered_set<int> m_listedShards;
+    std::unordered_map<std::string, int> m_chunkIds;    // hash -> id of stored chunks
+
+    int folderId(int parentId, const std::string& name);
+    int findChunk(int shardId, const std::string& hash);
+    bool loadManifest(int id, std::shared_ptr<const Manifest>& manifest);
+};
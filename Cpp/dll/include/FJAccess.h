@@ -25,12 +25,25 @@
 *
 * ============================================================================== =*/
 #include "FileJump.h"
+#include "CompressedFile.h"
+#include "ChunkStore.h"
+#include "NameIndex.h"
+#include "TreeCrawler.h"
+#include "Rcu.h"
+#include "Cancellation.h"
 
 #include <string>
 #include <vector>
 #include <list>
 #include <unordered_map>
+#include <unordered_set>
 #include <mutex>
+#include <condition_variable>
+#include <ctime>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <algorithm>
 #include <nlohmann/json.hpp>
 #include <Windows.h>
 using json = nlohmann::json;
@@ -41,6 +54,9 @@ struct FileInfo
 	{
 		path = {};
 		size = 0;
+		storedSize = 0;
+		compressed = false;
+		chunked = false;
 		isDir = false;
 		id = -1;
 		parent_id = -1;
@@ -49,8 +65,13 @@ struct FileInfo
 	}
 
 	std::string name;
+	std::string hash;
+	std::string description;
 	std::vector<int> path;
-	uint64_t size;
+	uint64_t size;          // size of the content as the user sees it
+	uint64_t storedSize;    // size of the object on the server, differs when compressed or chunked
+	bool compressed;
+	bool chunked;           // the object is a ChunkStore manifest
 	bool isDir;
 	int id;
 	int parent_id;
@@ -58,44 +79,258 @@ struct FileInfo
 	FILETIME updated_at;
 };
 
+struct DirectoryChange
+{
+	enum Kind { Added, Removed, Modified };
+	Kind kind;
+	FileInfo entry;
+};
+
 /**
 
     @class   DirectoryLru
     @brief   Class holds the LRU list of directories: name of directory -> list of files;
-    @details ~
+    @details Listings are immutable snapshots in an RcuMap, so get and contains take no lock; recency is a
+             per-listing stamp that readers bump atomically. Writers must be serialized by the caller.
+             put and erase apply a single created, replaced or deleted entry to a cached listing.
+             Kept listings (pinned folders) are never evicted and do not count towards CAPACITY.
 
 **/
 class DirectoryLru
 {
 private:
-	std::unordered_map <int, std::list<FileInfo>> filesLRU;
-	std::list <int> pathLRU;
+	struct Listing
+	{
+		std::shared_ptr<const std::list<FileInfo>> files;
+		std::shared_ptr<std::atomic<uint64_t>> used;
+	};
+	static const size_t CAPACITY = 21;
+	RcuMap<int, Listing> listings;
+	std::atomic<uint64_t> clock{ 0 };
+	std::unordered_set<int> kept;
+
+	// Replace the files of a cached listing, keeping its recency
+	template <class F>
+	bool change(int path, F fn)
+	{
+		return listings.modify(path, [&](Listing& l)
+			{
+				auto files = std::make_shared<std::list<FileInfo>>(*l.files);
+				if (!fn(*files))
+					return false;
+				l.files = files;
+				return true;
+			});
+	}
 public:
-	std::list<FileInfo> get(int path)
+	bool get(int path, std::list<FileInfo>& out)
 	{
-		if (filesLRU.count(path))
-		{
-			pathLRU.remove(path);
-			pathLRU.push_front(path);
-			// Key exists
-			return filesLRU[path];
-		}
-		return {};
+		Listing l;
+		if (!listings.find(path, l))
+			return false;
+		l.used->store(++clock, std::memory_order_relaxed);
+		out = *l.files;
+		return true;
+	}
+	bool contains(int path) const
+	{
+		return listings.contains(path);
+	}
+	// Cached directories, most recently used first
+	std::vector<int> keys() const
+	{
+		std::vector<std::pair<uint64_t, int>> order;
+		listings.forEach([&](int path, const Listing& l) { order.emplace_back(l.used->load(), path); });
+		std::sort(order.rbegin(), order.rend());
+		std::vector<int> out;
+		for (auto& o : order)
+			out.push_back(o.second);
+		return out;
+	}
+	// Replace a cached listing without changing its place in the LRU list
+	bool update(int path, const std::list<FileInfo>& data, std::list<FileInfo>& old)
+	{
+		return change(path, [&](std::list<FileInfo>& files)
+			{
+				old = files;
+				files = data;
+				return true;
+			});
 	}
 	void remove(int path)
 	{
-		filesLRU.erase(path);
-		pathLRU.remove(path);
+		listings.erase(path);
+	}
+	// Exempt the listing of path from eviction, or make it evictable again
+	void keep(int path, bool on)
+	{
+		if (on)
+			kept.insert(path);
+		else
+			kept.erase(path);
 	}
 	void add(int path, std::list<FileInfo> data)
 	{
-		if (pathLRU.size() > 20)
+		if (listings.size() >= CAPACITY && !listings.contains(path) && !kept.count(path))
 		{
-			int path_to_remove = pathLRU.back();
-			remove(path);
+			int path_to_remove = path;
+			uint64_t oldest = UINT64_MAX;
+			size_t evictable = 0;
+			listings.forEach([&](int p, const Listing& l)
+				{
+					if (kept.count(p))
+						return;
+					evictable++;
+					uint64_t used = l.used->load();
+					if (used < oldest)
+					{
+						oldest = used;
+						path_to_remove = p;
+					}
+				});
+			if (evictable >= CAPACITY)
+				remove(path_to_remove);
 		}
-		filesLRU[path] = data;
-		pathLRU.push_front(path);
+		Listing l;
+		l.files = std::make_shared<const std::list<FileInfo>>(std::move(data));
+		l.used = std::make_shared<std::atomic<uint64_t>>(++clock);
+		listings.set(path, l);
+	}
+	void put(int path, const FileInfo& entry)
+	{
+		change(path, [&](std::list<FileInfo>& files)
+			{
+				for (auto& e : files)
+				{
+					if (e.id == entry.id)
+					{
+						e = entry;
+						return true;
+					}
+				}
+				files.push_back(entry);
+				return true;
+			});
+	}
+	void erase(int path, int id)
+	{
+		change(path, [&](std::list<FileInfo>& files)
+			{
+				size_t before = files.size();
+				files.remove_if([id](const FileInfo& e) { return e.id == id; });
+				return files.size() != before;
+			});
+	}
+};
+
+/**
+
+    @class   StorageUrlCache
+    @brief   Class holds signed storage URLs that file-entries redirected to: id of file -> URL and its expiry time;
+    @details While the URL is valid, ranged reads go straight to the storage host and skip the API hop.
+
+**/
+class StorageUrlCache
+{
+private:
+	struct Entry
+	{
+		std::wstring url;
+		time_t expires;
+	};
+	std::unordered_map<int, Entry> urls;
+	std::mutex m_mutex;
+public:
+	bool get(int id, std::wstring& url)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		auto it = urls.find(id);
+		if (it == urls.end())
+			return false;
+		if (it->second.expires <= time(nullptr))
+		{
+			urls.erase(it);
+			return false;
+		}
+		url = it->second.url;
+		return true;
+	}
+	void remove(int id)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		urls.erase(id);
+	}
+	void add(int id, const std::wstring& url, time_t expires)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		if (urls.size() > 1000)
+		{
+			time_t now = time(nullptr);
+			for (auto it = urls.begin(); it != urls.end(); )
+				it = (it->second.expires <= now) ? urls.erase(it) : std::next(it);
+		}
+		urls[id] = { url, expires };
+	}
+};
+
+/**
+
+    @class   CompressionIndex
+    @brief   Class holds files uploaded with transparent compression: id of file -> size on the server and its seek table;
+    @details Filled from the description marker of every parsed entry; the seek table is fetched on first read.
+
+**/
+class CompressionIndex
+{
+private:
+	struct Entry
+	{
+		uint64_t storedSize;
+		bool hasTable;
+		CompressedFile::SeekTable table;
+	};
+	std::unordered_map<int, Entry> entries;
+	std::mutex m_mutex;
+public:
+	bool get(int id, uint64_t& storedSize)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		auto it = entries.find(id);
+		if (it == entries.end())
+			return false;
+		storedSize = it->second.storedSize;
+		return true;
+	}
+	bool getTable(int id, CompressedFile::SeekTable& table)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		auto it = entries.find(id);
+		if (it == entries.end() || !it->second.hasTable)
+			return false;
+		table = it->second.table;
+		return true;
+	}
+	void setTable(int id, const CompressedFile::SeekTable& table)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		auto it = entries.find(id);
+		if (it != entries.end())
+		{
+			it->second.table = table;
+			it->second.hasTable = true;
+		}
+	}
+	void add(int id, uint64_t storedSize)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		auto it = entries.find(id);
+		if (it == entries.end() || it->second.storedSize != storedSize)
+			entries[id] = { storedSize, false, {} };
+	}
+	void remove(int id)
+	{
+		std::lock_guard<std::mutex> guard(m_mutex);
+		entries.erase(id);
 	}
 };
 
@@ -108,21 +343,45 @@ public:
 **/
 class FILEJUMP_API FJAccess
 {
+	friend class ChunkStore;
+	friend class TreeCrawler;
 private:
 	static FJAccess* instance;
 	static std::wstring m_baseUrl;
 	static std::wstring m_bearerToken;
 	static bool verbose;
-	std::unordered_map <std::string, int> directoryCache;
-	std::unordered_map <int, std::string> directoryTranslate;
+	static bool compress;
+	static uint64_t dedupMinSize;
+	// Read without locks; updates are serialized by m_cache_mutex
+	RcuMap <std::string, int> directoryCache;
+	RcuMap <int, std::string> directoryTranslate;
 	DirectoryLru m_lru;
+	RcuMap<int, size_t> folderSizes;               // entries in folders listed so far
+	static const size_t largeFolder = 5000;        // names in bigger folders are looked up with a server-side query
+	StorageUrlCache m_storageUrls;
+	CompressionIndex m_compression;
+	ChunkStore m_chunks;
+	NameIndex m_index;
+	std::atomic<bool> m_indexReady{ false };
+	std::mutex m_index_mutex;       // serializes the lazy build
+	std::mutex m_warmup_mutex;
+	std::condition_variable m_warmupDone;
+	unsigned m_warmups = 0;         // warm-up crawls running, guarded by m_warmup_mutex
+	static const uint64_t CRAWL_RETRY_MS = 30000;
+	std::atomic<uint64_t> m_crawlRetryAt{ 0 };      // steady-clock ms before which a failed crawl is not repeated
 	static std::mutex m_cache_mutex;
 
 	std::string path2string(std::vector<int> path);
-	std::list<FileInfo> get_files(int path_id);
+	std::list<FileInfo> get_files(int path_id, const std::string& query = "", bool* ok = nullptr);
 	void fillDirectoryCache();
-	void read_directory_tree(int id = 0);
+	void ensureDirectoryCache();
+	void waitForWarmup();
+	void registerDirectories(const std::list<FileInfo>& entries);
 	FileInfo *json2fileinfo(const json & response, const std::string & subtree, FileInfo* buf);
+	bool readRaw(int id, uint64_t offset, uint64_t length, std::string& out);
+	bool readCompressed(int id, uint64_t storedSize, uint64_t offset, uint64_t length, std::string& out);
+	void applyCreated(const FileInfo& fi);
+	void forgetDirectory(int id);
 
 
 public:
@@ -131,6 +390,43 @@ public:
 	{
 		verbose = _verbose;
 	}
+	/**
+	 * @brief Turn on transparent compression of uploads (off by default)
+	 * @details Compressible files are stored in the CompressedFile format and marked in their description;
+	 *          reads of marked files are decompressed whatever this setting is.
+	 */
+	static void set_compression(bool _compress)
+	{
+		compress = _compress;
+	}
+	/**
+	 * @brief Store files of at least minSize bytes as deduplicated chunks (0 = off, the default)
+	 * @details See ChunkStore; reads of chunked files are reassembled whatever this setting is.
+	 */
+	static void set_dedup(uint64_t minSize)
+	{
+		dedupMinSize = minSize;
+	}
+	/**
+	 * @brief Hedge slow listing, metadata and range requests (off by default)
+	 * @details A GET slower than the 95th percentile of recent ones is sent again on another connection
+	 *          and the first response is used; at most 5% extra requests.
+	 */
+	static void set_hedging(bool enabled);
+	/**
+	 * @brief Fail requests at once while the server does not answer
+	 * @details After the given number of consecutive failed requests, requests fail without being sent
+	 *          for openMs, then one probe request decides whether the server is back. 0 turns it off.
+	 */
+	static void set_circuit_breaker(unsigned failures, unsigned openMs = 5000);
+	/**
+	 * @brief False while the circuit breaker keeps requests to the API from being sent
+	 */
+	static bool online();
+	/**
+	 * @brief Transport statistics as text (hedged requests, circuit breaker)
+	 */
+	static std::string transport_report();
 	static bool configure_with_password(const std::wstring& baseUrl, const std::string& user, const std::string& password);
 	static void configure(const std::wstring& base_url, const std::wstring& bearer_token)
 	{
@@ -142,11 +438,67 @@ public:
 
 	std::list <FileInfo> getDirectoryContent(int directoryID);
 	int getDirectoryID(std::string const& directoryPath);
+	/**
+	 * @brief Id of a known directory, from the directory cache only
+	 * @return id of the directory, 0 for the root, -1 when the path is not a known directory
+	 */
+	int lookupDirectoryID(std::string const& directoryPath);
+	/**
+	 * @brief Read one entry by its id with a single request, without listing its parent
+	 */
+	bool statEntry(int id, FileInfo& out);
+	/**
+	 * @brief Path of a known directory, like "/docs/2024/"; empty when the id is not a known directory
+	 */
+	std::string getDirectoryPath(int id);
+	/**
+	 * @brief Ids of the directories whose listings are cached
+	 */
+	std::vector<int> cachedDirectories();
+	/**
+	 * @brief Keep the cached listing of a directory out of LRU eviction (pinned folders), or return it to the LRU
+	 */
+	void keepDirectory(int id, bool keep);
+	/**
+	 * @brief List a cached directory again and apply the differences to the caches and the name index
+	 * @param changes receives the entries added, removed and modified since the cached listing
+	 * @return false when the directory is not cached or the listing failed
+	 */
+	bool refreshDirectory(int id, std::vector<DirectoryChange>& changes);
 	const struct FileInfo* findFile(const std::string& path);
 	bool copyFile(int id, const std::string& dest);
+	bool readFile(int id, uint64_t offset, uint64_t length, std::string& out);
+	bool downloadArchive(const std::list<FileInfo>& entries, const std::function<bool(const FileInfo&, const std::string&)>& onFile);
+	bool downloadArchive(const std::list<FileInfo>& entries, const std::string& targetDir);
 	bool deleteFile(int parent_id, int id);
-	bool createDir(int id, const std::string& name);
-	bool uploadFile(const std::string& source, int remotePathId, const std::string& remoteName);
+	bool createDir(int id, const std::string& name, FileInfo* created = nullptr);
+	bool uploadFile(const std::string& source, int remotePathId, const std::string& remoteName,
+		FileInfo* uploaded = nullptr, const std::string& description = "", const CancellationToken* cancel = nullptr);
+
+	/**
+	 * @brief Crawl the whole remote tree in parallel into the name index
+	 * @details Listings fetched later (browsing) keep the index up to date once it is built.
+	 */
+	bool buildIndex(unsigned threads = 8);
+	/**
+	 * @brief Crawl the whole remote tree with crawler: fills the directory cache and rebuilds the name index
+	 * @details Call crawler.cancel() from another thread to stop; the index is then left incomplete.
+	 *          Folder lookups that need the directory cache meanwhile wait for the warm-up instead of
+	 *          crawling the tree themselves.
+	 * @return false when cancelled or when some folders could not be listed
+	 */
+	bool warmup(TreeCrawler& crawler, const TreeCrawler::OnProgress& progress = nullptr);
+	/**
+	 * @brief Query the name index
+	 * @param build build the index first when it is not complete; false searches what is indexed so far
+	 */
+	std::vector<NameIndex::Match> search(const NameIndex::Query& query, bool build = true);
+	/**
+	 * @brief Check whether the name index covers the whole remote tree
+	 */
+	bool indexReady() const { return m_indexReady; }
+	bool saveIndex(const std::string& file);
+	bool loadIndex(const std::string& file);
 
 	static FJAccess* getInstance()
 	{
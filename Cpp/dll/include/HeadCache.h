@@ -0,0 +1,78 @@
+#pragma once
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <mutex>
+#include <cstdint>
+#include "FileJump.h"
+
+/**
+ * @brief First bytes of files, kept so type detection and thumbnail reads do not download whole files
+ *
+ * Each entry holds up to headSize bytes of a file version; an entry shorter than headSize is the whole file.
+ * The least recently used entries are dropped when the total exceeds the capacity.
+ */
+class FILEJUMP_API HeadCache
+{
+public:
+    HeadCache(size_t headSize, uint64_t capacity);
+
+    size_t headSize() const { return m_headSize; }
+
+    /**
+     * @brief Copy a range of a cached head into buf
+     * @param got number of bytes copied, less than length only at the end of the file
+     * @return false when the head of this version is not cached or does not cover the range
+     */
+    bool read(int id, uint64_t version, uint64_t offset, size_t length, char* buf, size_t& got);
+    bool contains(int id, uint64_t version) const;
+    /**
+     * @brief Store the head of a file; data is truncated to headSize
+     */
+    void put(int id, uint64_t version, std::string data);
+    void remove(int id);
+
+    bool save(const std::string& file) const;
+    bool load(const std::string& file);
+
+private:
+    struct Head
+    {
+        uint64_t version;
+        std::string data;
+        std::list<int>::iterator pos;
+    };
+    size_t m_headSize;
+    uint64_t m_capacity;
+    uint64_t m_bytes = 0;
+    std::unordered_map<int, Head> heads;
+    std::list<int> order;          // most recently used first
+    mutable std::mutex m_mutex;
+
+    void erase(std::unordered_map<int, Head>::iterator it);
+};
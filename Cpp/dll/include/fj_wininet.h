@@ -27,6 +27,10 @@
 
 #include <string>
 #include <map>
+#include <cstdint>
+#include <functional>
+
+class CancellationToken;
 
 struct FileField {
     std::string fieldName;
@@ -38,9 +42,68 @@ struct TextField {
     std::string value;
 };
 
+/**
+ * Connection pool a request is sent through. API calls carry the bearer token;
+ * storage downloads go to the redirect target and keep their own keep-alive sockets.
+ */
+enum class HttpPool {
+    Api,
+    Storage
+};
+
+typedef std::function<bool(const char* data, size_t size)> HttpBodySink;
+
+struct HttpResponse {
+    unsigned long status = 0;   // HTTP status, 0 when the request did not complete
+    std::string body;
+    std::wstring location;      // Location header of a 3xx response
+};
+
+
+struct HttpHedgeStats {
+    uint64_t requests;          // GETs that could be hedged
+    uint64_t hedged;            // second requests sent
+    uint64_t hedgeWins;         // second requests that answered first
+    unsigned thresholdMs;       // current hedging delay
+};
+
+/**
+ * Hedge idempotent GETs (listings, metadata, range reads): resend a request that has not answered
+ * within the given percentile of recent times to first byte, using at most budget extra requests
+ * per request. Whole-file downloads are not hedged.
+ */
+void HttpSetHedging(bool enabled, double percentile = 0.95, double budget = 0.05);
+HttpHedgeStats HttpGetHedgeStats();
+
+enum class HttpCircuitState {
+    Closed,                     // requests go through
+    Open,                       // requests fail at once
+    HalfOpen                    // one probe request decides
+};
+
+struct HttpCircuitStats {
+    HttpCircuitState state;
+    unsigned failures;          // consecutive failed requests
+    uint64_t trips;             // times the circuit opened
+    uint64_t rejected;          // requests failed without being sent
+};
+
+/**
+ * Fail requests of a pool at once for openMs after the given number of consecutive failures
+ * (no response, timeout or 5xx), then let one probe request through; 0 failures turns it off.
+ */
+void HttpSetCircuitBreaker(unsigned failures, unsigned openMs = 5000);
+HttpCircuitStats HttpGetCircuitStats(HttpPool pool = HttpPool::Api);
+// False while the circuit of the pool is open
+bool HttpAvailable(HttpPool pool = HttpPool::Api);
 
 std::string HttpGet(const std::wstring& url, const std::wstring& headers);
+HttpResponse HttpGetNoRedirect(const std::wstring& url, const std::wstring& headers,
+    uint64_t offset = 0, uint64_t length = 0, HttpPool pool = HttpPool::Api);
+HttpResponse HttpGetStream(const std::wstring& url, const std::wstring& headers,
+    const HttpBodySink& sink, HttpPool pool = HttpPool::Api);
 std::string HttpRequest(const std::wstring& method, const std::wstring& url, const std::wstring& headers, const std::string& data);
 std::string HttpDelete(const std::wstring& url, const std::wstring& header, const std::string& data);
 std::string HttpPost(const std::wstring& url, const std::wstring& headers, const std::string& data);
-std::string HttpPostMultipart(const std::wstring& url, const std::wstring& token, const std::map<std::string, std::string>& fields, const std::string& fileName);
+std::string HttpPostMultipart(const std::wstring& url, const std::wstring& token, const std::map<std::string, std::string>& fields, const std::string& fileName,
+    const CancellationToken* cancel = nullptr);
@@ -20,6 +20,7 @@
 # OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 # SOFTWARE.
 
+import hashlib
 import json
 import mimetypes
 import os
@@ -32,6 +33,8 @@ from requests_toolbelt.multipart.encoder import MultipartEncoder, MultipartEncod
 #from fj_sync.Globals import Globals
 from .Exceptions import FJError
 from .HttpRequest import HttpRequest
+from .LocalFileReader import LocalFileReader
+from . import native
 
 
 logger = logging.getLogger(__name__)
@@ -53,6 +56,9 @@ class FileJumpApi:
        - File metadata management (description, info)
        - File deletion
 
+       When the native extension (FileJump._fjnative) is installed, tree loading, downloads,
+       bulk uploads and hashing run in the C++ library, in parallel and without holding the GIL.
+
        Usage:
            api = FileJumpApi()
            api.login(email, password)
@@ -217,6 +223,54 @@ class FileJumpApi:
         return out_data
 
 
+    def post_files(self, files_list, percent_callback=None, threads=4):
+        """
+        Upload several files; in parallel when the native extension is installed.
+
+        :param files_list: List of dicts with 'path' (local file), 'relative_path' (path in FileJump)
+                           and optional 'description'
+        :param percent_callback: Callback with file_progress(file_path, done, total), called as files complete
+        :param threads: Number of parallel uploads (native only)
+        :return: List with the post_file response ({"fileEntry": ...}) or None for every file
+        """
+        self.cancel = False
+        fj = native.get(self.base_url, self.token)
+        if fj is not None:
+            items = [(f["path"], 0, os.path.normpath(f["relative_path"]).replace("\\", "/"), f.get("description") or "")
+                     for f in files_list]
+
+            def progress(index, ok):
+                # the same per-file byte counts as post_file reports; returning True stops the uploads
+                if percent_callback and ok:
+                    size = os.path.getsize(items[index][0])
+                    percent_callback.file_progress(items[index][0], size, size)
+                return self.cancel
+            entries = fj.upload_files(items, threads=threads, progress=progress)
+            return [{"fileEntry": e} if e is not None else None for e in entries]
+        out = []
+        for f in files_list:
+            if self.cancel:
+                break
+            with LocalFileReader(f["path"]) as reader:
+                res = self.post_file(f["path"], reader, f["relative_path"], percent_callback)
+            if res and f.get("description") and res.get("fileEntry"):
+                self.set_description(res["fileEntry"]["id"], f["description"])
+            out.append(res)
+        return out
+
+    @staticmethod
+    def calculate_sha256(file_path):
+        """
+        SHA-256 of a local file as a hex string; native when the extension is installed.
+        """
+        if native.available():
+            return native._fjnative.sha256_file(file_path)
+        digest = hashlib.sha256()
+        with open(file_path, "rb") as f:
+            for block in iter(lambda: f.read(1024 * 1024), b""):
+                digest.update(block)
+        return digest.hexdigest()
+
     def get_files(self, path_id=None):
         files = list()
         if path_id:
@@ -316,7 +370,23 @@ class FileJumpApi:
         """
         chunk_size = 16384  # 16 MB
         self.cancel = False
+        fj = native.get(self.base_url, self.token)
+        if fj is not None:
+            items = [(int(file["id"]), os.path.join(target_dir, file["name"]))
+                     for file in files_list if file.get("id") and file.get("name")]
+
+            def progress(index, ok):
+                # per-file percent like the loop below; returning True stops the downloads
+                if not ok and not self.cancel:
+                    logger.error("Failed to download %s", items[index][1])
+                if percent_callback and ok:
+                    percent_callback(100)
+                return self.cancel
+            fj.download_files(items, progress=progress)
+            return
         for file in files_list:
+            if self.cancel:
+                break
             entry_id = file.get("id")
             name = file.get("name")
             if not entry_id or not name:
@@ -346,6 +416,11 @@ class FileJumpApi:
         folders = []
         if self.cancel:
             return all_entries, folders
+        fj = native.get(self.base_url, self.token)
+        if fj is not None:
+            all_entries, folders = fj.read_directory_tree(int(path_id or 0))
+            logger.info(f"Reading directory tree for path_id: {path_id} Done. Found {len(all_entries)} entries.")
+            return all_entries, folders
         entries = self.get_files(path_id)
         if not entries:
             return all_entries, folders
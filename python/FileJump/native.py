@@ -0,0 +1,61 @@
+# MIT License
+#
+# Copyright (c) 2025 Lev Zlotin
+#
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+#
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+#
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+"""
+Access to the native FileJump library (extension module FileJump._fjnative).
+
+The extension is built from ../Cpp/FileJump by setup.py on Windows when pybind11 is
+installed. Without it, ``get()`` returns None and FileJumpApi uses its pure Python code.
+"""
+import logging
+
+logger = logging.getLogger(__name__)
+
+try:
+    from . import _fjnative
+except ImportError:
+    _fjnative = None
+
+_configured = None
+
+
+def available():
+    """
+    :return: True when the native extension is installed
+    """
+    return _fjnative is not None
+
+
+def get(base_url, token):
+    """
+    Returns the native module configured for the given server and token, or None
+    when the extension is not installed or the API is not configured yet.
+
+    :param base_url: FileJumpApi.base_url, like "https://app.filejump.com/api/v1/"
+    :param token: FileJumpApi.token
+    """
+    global _configured
+    if _fjnative is None or not base_url or not token:
+        return None
+    if _configured != (base_url, token):
+        _fjnative.configure(base_url, token)
+        _configured = (base_url, token)
+    return _fjnative
@@ -0,0 +1,311 @@
+/* ============================================================================== =
+*
+*MIT License
+*
+*Copyright(c) 2025 Lev Zlotin
+*
+*Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files(the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and /or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions :
+*
+*The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+*THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*
+* ============================================================================== =*/
+
+// Python extension FileJump._fjnative: native listing, tree loading, transfers and hashing
+// on top of the FileJump C++ library. Every call that does I/O releases the GIL.
+
+#include <pybind11/pybind11.h>
+#include <pybind11/stl.h>
+#include <pybind11/functional.h>
+
+#include <string>
+#include <vector>
+#include <tuple>
+#include <unordered_map>
+#include <mutex>
+#include <cstdio>
+
+#include "FJAccess.h"
+#include "CUrlTools.h"
+#include "SyncEngine.h"
+#include "TaskPool.h"
+#include "TreeCrawler.h"
+
+namespace py = pybind11;
+
+// Python FileJumpApi keeps the base URL with the "api/v1/" suffix, FJAccess without it
+static std::wstring nativeBaseUrl(const std::string& baseUrl)
+{
+    std::string url = baseUrl;
+    const std::string suffix = "api/v1/";
+    if (url.size() >= suffix.size() && url.compare(url.size() - suffix.size(), suffix.size(), suffix) == 0)
+        url.resize(url.size() - suffix.size());
+    if (!url.empty() && url.back() != '/')
+        url += '/';
+    return CUrlTools::Utf8ToWide(url);
+}
+
+// Same format as the timestamps in API responses
+static std::string fileTimeToString(const FILETIME& ft)
+{
+    SYSTEMTIME st;
+    if ((ft.dwLowDateTime == 0 && ft.dwHighDateTime == 0) || !FileTimeToSystemTime(&ft, &st))
+        return {};
+    char buf[40];
+    snprintf(buf, sizeof(buf), "%04u-%02u-%02uT%02u:%02u:%02u.%06uZ", st.wYear, st.wMonth, st.wDay,
+        st.wHour, st.wMinute, st.wSecond, st.wMilliseconds * 1000u);
+    return buf;
+}
+
+// Entry in the shape of the "data" items FileJumpApi.get_files returns
+static py::dict entryToDict(const FileInfo& fi)
+{
+    std::string path;
+    for (int id : fi.path)
+    {
+        if (!path.empty())
+            path += '/';
+        path += std::to_string(id);
+    }
+    py::dict d;
+    d["id"] = fi.id;
+    d["name"] = fi.name;
+    d["type"] = fi.isDir ? "folder" : "file";
+    d["file_size"] = fi.size;
+    d["parent_id"] = fi.parent_id > 0 ? py::object(py::int_(fi.parent_id)) : py::object(py::none());
+    d["path"] = path;
+    d["hash"] = fi.hash;
+    d["description"] = fi.description.empty() ? py::object(py::none()) : py::object(py::str(fi.description));
+    d["created_at"] = fileTimeToString(fi.created_at);
+    d["updated_at"] = fileTimeToString(fi.updated_at);
+    return d;
+}
+
+static py::list entriesToList(const std::vector<FileInfo>& entries)
+{
+    py::list out;
+    for (auto& fi : entries)
+        out.append(entryToDict(fi));
+    return out;
+}
+
+// Calls a Python progress callback from a worker thread; its exceptions must not reach TaskPool.
+// Returns true when the callback asks to stop (returns a true value)
+static bool notify(const py::object& progress, size_t index, bool ok)
+{
+    py::gil_scoped_acquire acquire;
+    try
+    {
+        return py::bool_(progress(index, ok));
+    }
+    catch (py::error_already_set& e)
+    {
+        e.discard_as_unraisable("FileJump._fjnative progress callback");
+    }
+    return false;
+}
+
+static void configure(const std::string& baseUrl, const std::string& token)
+{
+    FJAccess::configure(nativeBaseUrl(baseUrl), CUrlTools::Utf8ToWide(token));
+}
+
+static bool login(const std::string& baseUrl, const std::string& email, const std::string& password)
+{
+    py::gil_scoped_release release;
+    return FJAccess::configure_with_password(nativeBaseUrl(baseUrl), email, password);
+}
+
+static py::list getFiles(int folderId)
+{
+    std::list<FileInfo> entries;
+    {
+        py::gil_scoped_release release;
+        entries = FJAccess::getInstance()->getDirectoryContent(folderId);
+    }
+    return entriesToList(std::vector<FileInfo>(entries.begin(), entries.end()));
+}
+
+/**
+ * Loads the whole tree under a folder, listing folders in parallel.
+ * Returns (entries, folders) like FileJumpApi.read_directory_tree, including the "empty" flags.
+ */
+static py::tuple readDirectoryTree(int folderId, unsigned threads)
+{
+    std::vector<FileInfo> entries;
+    {
+        py::gil_scoped_release release;
+        TreeCrawler crawler(FJAccess::getInstance(), threads);
+        crawler.crawl(folderId, [&](int, const std::list<FileInfo>& content)
+            {
+                entries.insert(entries.end(), content.begin(), content.end());
+            });
+    }
+
+    std::unordered_map<int, bool> hasChildren;
+    for (auto& fi : entries)
+        if (fi.parent_id > 0)
+            hasChildren[fi.parent_id] = true;
+    py::list all, folders;
+    for (auto& fi : entries)
+    {
+        py::dict d = entryToDict(fi);
+        d["empty"] = !(fi.isDir && hasChildren.count(fi.id));
+        all.append(d);
+        if (fi.isDir)
+            folders.append(d);
+    }
+    return py::make_tuple(all, folders);
+}
+
+/**
+ * Uploads files in parallel. items: (local path, parent id, name, description or "").
+ * Returns the created entries, None for files that failed or were not uploaded after a stop.
+ * progress(index, ok) is called as files complete; when it returns True, the uploads running
+ * are cancelled and the remaining files are skipped.
+ */
+static py::list uploadFiles(const std::vector<std::tuple<std::string, int, std::string, std::string>>& items,
+    unsigned threads, const py::object& progress)
+{
+    std::vector<FileInfo> uploaded(items.size());
+    std::vector<char> ok(items.size(), 0);
+    bool report = !progress.is_none();
+    CancellationToken cancel;
+    {
+        py::gil_scoped_release release;
+        TaskPool pool(threads);
+        for (size_t i = 0; i < items.size(); i++)
+            pool.submit([&, i]
+                {
+                    if (cancel.cancelled())
+                        return;
+                    auto& item = items[i];
+                    // a task of the pool must not throw, and nothing may unwind into the interpreter
+                    try
+                    {
+                        ok[i] = FJAccess::getInstance()->uploadFile(std::get<0>(item), std::get<1>(item), std::get<2>(item),
+                            &uploaded[i], std::get<3>(item), &cancel);
+                    }
+                    catch (...)
+                    {
+                        ok[i] = 0;
+                    }
+                    if (report && notify(progress, i, ok[i] != 0))
+                        cancel.cancel();
+                });
+        pool.wait();
+    }
+    py::list out;
+    for (size_t i = 0; i < items.size(); i++)
+        out.append(ok[i] ? py::object(entryToDict(uploaded[i])) : py::object(py::none()));
+    return out;
+}
+
+/**
+ * Downloads files in parallel. items: (entry id, destination path).
+ * Returns a success flag per file; progress(index, ok) is called as files complete and stops
+ * the downloads like in uploadFiles when it returns True.
+ */
+static std::vector<bool> downloadFiles(const std::vector<std::tuple<int, std::string>>& items, unsigned threads,
+    const py::object& progress)
+{
+    std::vector<char> ok(items.size(), 0);
+    bool report = !progress.is_none();
+    CancellationToken cancel;
+    {
+        py::gil_scoped_release release;
+        TaskPool pool(threads);
+        for (size_t i = 0; i < items.size(); i++)
+            pool.submit([&, i]
+                {
+                    if (cancel.cancelled())
+                        return;
+                    CancellationToken::Scope scope(&cancel);
+                    try
+                    {
+                        ok[i] = FJAccess::getInstance()->copyFile(std::get<0>(items[i]), std::get<1>(items[i]));
+                    }
+                    catch (...)
+                    {
+                        ok[i] = 0;
+                    }
+                    if (report && notify(progress, i, ok[i] != 0))
+                        cancel.cancel();
+                });
+        pool.wait();
+    }
+    return std::vector<bool>(ok.begin(), ok.end());
+}
+
+static std::string sha256File(const std::string& path)
+{
+    py::gil_scoped_release release;
+    return SyncEngine::fileSha256(std::filesystem::u8path(path));
+}
+
+static std::vector<std::string> sha256Files(const std::vector<std::string>& paths, unsigned threads)
+{
+    std::vector<std::string> out(paths.size());
+    py::gil_scoped_release release;
+    TaskPool pool(threads);
+    for (size_t i = 0; i < paths.size(); i++)
+        pool.submit([&, i] { out[i] = SyncEngine::fileSha256(std::filesystem::u8path(paths[i])); });
+    pool.wait();
+    return out;
+}
+
+static py::dict sync(const std::string& localDir, const std::string& remotePath, unsigned threads,
+    bool deleteExtra, bool compareHash, bool dryRun)
+{
+    SyncOptions options;
+    options.threads = threads;
+    options.deleteExtra = deleteExtra;
+    options.compareHash = compareHash;
+    options.dryRun = dryRun;
+    SyncStats stats;
+    bool ok;
+    {
+        py::gil_scoped_release release;
+        SyncEngine engine(FJAccess::getInstance());
+        ok = engine.sync(localDir, remotePath, options, stats);
+    }
+    py::dict d;
+    d["ok"] = ok;
+    d["scanned"] = stats.scanned;
+    d["uploaded"] = stats.uploaded;
+    d["skipped"] = stats.skipped;
+    d["folders"] = stats.folders;
+    d["deleted"] = stats.deleted;
+    d["failed"] = stats.failed;
+    d["bytes"] = stats.bytes;
+    return d;
+}
+
+PYBIND11_MODULE(_fjnative, m)
+{
+    m.doc() = "Native FileJump access used by FileJump.FileJumpApi when available";
+    m.def("configure", &configure, py::arg("base_url"), py::arg("token"));
+    m.def("login", &login, py::arg("base_url"), py::arg("email"), py::arg("password"));
+    m.def("set_verbose", &FJAccess::set_verbose, py::arg("verbose"));
+    m.def("get_files", &getFiles, py::arg("folder_id") = 0);
+    m.def("read_directory_tree", &readDirectoryTree, py::arg("folder_id") = 0, py::arg("threads") = 8);
+    m.def("upload_files", &uploadFiles, py::arg("items"), py::arg("threads") = 4, py::arg("progress") = py::none());
+    m.def("download_files", &downloadFiles, py::arg("items"), py::arg("threads") = 4, py::arg("progress") = py::none());
+    m.def("sha256_file", &sha256File, py::arg("path"));
+    m.def("sha256_files", &sha256Files, py::arg("paths"), py::arg("threads") = 4);
+    m.def("sync", &sync, py::arg("local_dir"), py::arg("remote_path"), py::arg("threads") = 4,
+        py::arg("delete") = false, py::arg("hash") = false, py::arg("dry_run") = false);
+}
@@ -1,4 +1,6 @@
+import glob
 import os.path
+import sys
 
 from setuptools import setup, find_packages
 
@@ -21,6 +23,28 @@ package_name = "fj_sync"
 # build package_dir first
 packages=find_packages(exclude=['tests*', 'docs*']),
 
+# Native extension FileJump._fjnative, built from the C++ library when pybind11 is available (Windows only).
+# nlohmann/json must be on the include path, e.g. in ../Cpp/include as for the Visual Studio build.
+ext_modules = []
+if sys.platform == "win32":
+    try:
+        from pybind11.setup_helpers import Pybind11Extension, build_ext
+    except ImportError:
+        Pybind11Extension = None
+    if Pybind11Extension is not None:
+        cpp_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "Cpp")
+        sources = [os.path.join("native", "fjnative.cpp")] + \
+            [f for f in glob.glob(os.path.join(cpp_dir, "FileJump", "*.cpp")) if not f.endswith("dllmain.cpp")]
+        ext_modules.append(Pybind11Extension(
+            "FileJump._fjnative",
+            sources=sources,
+            include_dirs=[os.path.join(cpp_dir, "FileJump", "include"), os.path.join(cpp_dir, "include")],
+            define_macros=[("FILEJUMP_EXPORTS", None), ("UNICODE", None), ("_UNICODE", None)],
+            libraries=["wininet", "Cabinet", "bcrypt"],
+            cxx_std=17,
+        ))
+        kwargs["cmdclass"] = {"build_ext": build_ext}
+
 setup(name=package_name,
       version=__version__.get_full_version(),
       description='file jump synchronizer',
@@ -29,6 +53,7 @@ setup(name=package_name,
       author_email='lev.zlotin@gmail.com',
       packages=packages,
       include_package_data=True,
+      ext_modules=ext_modules,
       install_requires=[
           "requests",
           "requests_toolbelt",